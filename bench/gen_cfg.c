@@ -0,0 +1,160 @@
+/* Generator of synthetic C translation units for the compile-time benchmark of the plugin */
+/* every function is a chain of if/else diamonds, optionally nested, wrapped in loops, */
+/* with early returns and MPI collectives spread over the branches */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int nb_functions = 1;
+static int nb_diamonds = 8;
+static int nesting = 1;
+static int nb_loops = 0;
+static int nb_returns = 0;
+static int nb_collectives = 4;
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-f functions] [-d diamonds] [-n nesting] [-l loops] [-r returns] [-c collectives]\n", name);
+	fprintf(stderr, "  -f  number of functions in the translation unit (default 1)\n");
+	fprintf(stderr, "  -d  number of if/else diamonds per function (default 8)\n");
+	fprintf(stderr, "  -n  number of diamonds nested into each other (default 1, not nested)\n");
+	fprintf(stderr, "  -l  number of loops wrapping the diamonds (default 0)\n");
+	fprintf(stderr, "  -r  number of early returns per function (default 0)\n");
+	fprintf(stderr, "  -c  number of MPI collectives per function (default 4)\n");
+	exit(1);
+}
+
+static void indent(int depth)
+{
+	for (int i = 0; i < depth; i++) putchar('\t');
+}
+
+/* returns 1 if the k-th element out of total is placed on the given diamond */
+static int placed_on(int diamond, int k, int total)
+{
+	return (int) ((long) k * nb_diamonds / total) == diamond;
+}
+
+/* statements of one branch of a diamond: some computation, maybe a collective and an early return */
+static void emit_branch(int diamond, int is_else, int depth)
+{
+	indent(depth);
+	printf("acc = acc %c %d;\n", is_else ? '-' : '+', diamond + 1);
+
+	for (int k = 0; k < nb_collectives; k++) {
+		if (placed_on(diamond, k, nb_collectives) && (k % 3 == 1) == is_else && k % 3 != 2) {
+			indent(depth);
+			printf("MPI_Barrier(MPI_COMM_WORLD);\n");
+		}
+	}
+	for (int k = 0; k < nb_returns; k++) {
+		if (!is_else && placed_on(diamond, k, nb_returns)) {
+			indent(depth);
+			printf("if (acc > %d)\n", 1000 + diamond);
+			indent(depth + 1);
+			printf("return acc;\n");
+		}
+	}
+}
+
+/* collectives placed after a diamond, on the straight-line path */
+static void emit_join(int diamond, int depth)
+{
+	for (int k = 0; k < nb_collectives; k++) {
+		if (placed_on(diamond, k, nb_collectives) && k % 3 == 2) {
+			indent(depth);
+			printf("MPI_Barrier(MPI_COMM_WORLD);\n");
+		}
+	}
+}
+
+/* emits the diamonds [first, last) nested by groups of 'nesting' */
+static void emit_diamonds(int first, int last, int depth)
+{
+	for (int group = first; group < last; group += nesting) {
+		int end = group + nesting < last ? group + nesting : last;
+
+		for (int d = group; d < end; d++) {
+			int level = depth + d - group;
+			indent(level);
+			printf("if ((rank + %d) %% %d < %d)\n", d, d % 5 + 2, d % 3 + 1);
+			indent(level);
+			printf("{\n");
+			emit_branch(d, 0, level + 1);
+		}
+		for (int d = end - 1; d >= group; d--) {
+			int level = depth + d - group;
+			indent(level);
+			printf("}\n");
+			indent(level);
+			printf("else\n");
+			indent(level);
+			printf("{\n");
+			emit_branch(d, 1, level + 1);
+			indent(level);
+			printf("}\n");
+			emit_join(d, level);
+		}
+	}
+}
+
+static void emit_function(int f)
+{
+	printf("int kernel_%d(int rank, int n)\n{\n", f);
+	printf("\tint acc = rank;\n");
+	for (int l = 0; l < nb_loops; l++) printf("\tint i%d;\n", l);
+	printf("\n");
+
+	if (nb_diamonds == 0) {
+		for (int k = 0; k < nb_collectives; k++) printf("\tMPI_Barrier(MPI_COMM_WORLD);\n");
+	}
+
+	/* the diamonds are split into nb_loops + 1 regions, each but the first one is wrapped in a loop */
+	int regions = nb_loops + 1;
+	for (int r = 0; r < regions; r++) {
+		int first = (int) ((long) r * nb_diamonds / regions);
+		int last = (int) ((long) (r + 1) * nb_diamonds / regions);
+		if (r == 0) {
+			emit_diamonds(first, last, 1);
+		}
+		else {
+			printf("\tfor (i%d = 0; i%d < n; i%d++)\n\t{\n", r - 1, r - 1, r - 1);
+			emit_diamonds(first, last, 2);
+			printf("\t}\n");
+		}
+	}
+
+	printf("\n\treturn acc;\n}\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:d:n:l:r:c:")) != -1) {
+		switch (opt) {
+		case 'f': nb_functions = atoi(optarg); break;
+		case 'd': nb_diamonds = atoi(optarg); break;
+		case 'n': nesting = atoi(optarg); break;
+		case 'l': nb_loops = atoi(optarg); break;
+		case 'r': nb_returns = atoi(optarg); break;
+		case 'c': nb_collectives = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (nb_functions < 1 || nb_diamonds < 0 || nesting < 1 || nb_loops < 0 || nb_returns < 0 || nb_collectives < 0)
+		usage(argv[0]);
+
+	printf("/* generated by gen_cfg -f %d -d %d -n %d -l %d -r %d -c %d */\n\n",
+			nb_functions, nb_diamonds, nesting, nb_loops, nb_returns, nb_collectives);
+	printf("#include <mpi.h>\n\n");
+
+	printf("#pragma Projet_CA mpicoll_check (");
+	for (int f = 0; f < nb_functions; f++) printf("%skernel_%d", f ? ", " : "", f);
+	printf(")\n\n");
+
+	for (int f = 0; f < nb_functions; f++) emit_function(f);
+
+	return 0;
+}
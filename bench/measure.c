@@ -0,0 +1,46 @@
+/* Runs a command and prints its wall time in seconds and its peak resident set size in kB */
+/* the peak RSS includes the children waited for by the command, i.e. cc1 for the gcc driver */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+int main(int argc, char *argv[])
+{
+	struct timespec start, end;
+	struct rusage usage;
+	int status;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s command [args...]\n", argv[0]);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		execvp(argv[1], &argv[1]);
+		perror(argv[1]);
+		_exit(127);
+	}
+
+	if (wait4(pid, &status, 0, &usage) < 0) {
+		perror("wait4");
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%.3f\t%ld\n", wall, usage.ru_maxrss);
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Compile-time benchmark of the plugin on generated CFGs
+# every case is compiled without and with the plugin, the wall time (s) and peak RSS (kB) are recorded
+#
+# environment: BIN_DIR (gen_cfg, measure and libplugin.so), OUT_DIR, MPICC,
+#              BENCH_SIZES (numbers of diamonds), BENCH_FUNCTIONS (functions per translation unit)
+
+set -e
+
+BIN_DIR=$(cd "${BIN_DIR:-bin}" && pwd)
+OUT_DIR=${OUT_DIR:-bench/out}
+MPICC=${MPICC:-mpicc}
+SIZES=${BENCH_SIZES:-"8 16 32 64 128 256"}
+FUNCTIONS=${BENCH_FUNCTIONS:-4}
+
+mkdir -p "$OUT_DIR"
+cd "$OUT_DIR"
+
+RESULTS=results.tsv
+: > bench.log
+printf "case\tdiamonds\tfunctions\tbaseline_s\tbaseline_kb\tplugin_s\tplugin_kb\n" > $RESULTS
+
+for shape in chain nested loops returns; do
+	for n in $SIZES; do
+		case $shape in
+		chain)   options="-d $n -c $((n / 2))" ;;
+		nested)  options="-d $n -n 8 -c $((n / 2))" ;;
+		loops)   options="-d $n -n 4 -l $((n / 8 + 1)) -c $((n / 2))" ;;
+		returns) options="-d $n -n 4 -r $((n / 4 + 1)) -c $((n / 2))" ;;
+		esac
+
+		src=bench_${shape}_$n.c
+		"$BIN_DIR/gen_cfg" -f $FUNCTIONS $options > $src
+
+		# the compiler output goes to bench.log, measure prints its result on the last line
+		if out=$("$BIN_DIR/measure" $MPICC -c $src -o /dev/null 2>>bench.log); then
+			baseline=$(echo "$out" | tail -n 1)
+		else
+			baseline="failed	failed"
+		fi
+		if out=$("$BIN_DIR/measure" $MPICC -c $src -o /dev/null -fplugin="$BIN_DIR/libplugin.so" 2>>bench.log); then
+			plugin=$(echo "$out" | tail -n 1)
+		else
+			plugin="failed	failed"
+		fi
+
+		printf "%s\t%d\t%d\t%s\t%s\n" $shape $n $FUNCTIONS "$baseline" "$plugin" | tee -a $RESULTS
+	done
+done
+
+echo "results written to $OUT_DIR/$RESULTS"
@@ -0,0 +1,65 @@
+/* Binary format of the CFGs exported by -fplugin-arg-libplugin-export=<file> and read by mpicoll-analyze */
+
+/* Every integer is an unsigned LEB128 varint, a string is its length followed by its bytes.
+ *
+ * file:     MPICOLL_CFG_MAGIC (4 bytes), version, number of collectives, name of each collective,
+ *           then one record per checked function until the end of the file
+ * function: name, file, line, number of classes, code of the collectives of each class,
+ *           number of block indexes, then each block index in order
+ * block:    present (0 when the index is not used, nothing follows),
+ *           number of successors, index of each successor in edge order,
+ *           number of collective entries, each entry being: class, count, line, column,
+ *           line and column of the last statement (0 0 when the block is empty),
+ *           1 if the block ends with a fork that may depend on the process, 0 otherwise
+ *
+ * Block 0 is the entry and block 1 the exit, as in GCC. The CFG is the one after the split
+ * of the blocks containing several collectives. A class is a collective on one communicator,
+ * the sets are built for each class.
+ */
+
+#ifndef MPICOLL_CFG_H
+#define MPICOLL_CFG_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define MPICOLL_CFG_MAGIC "MPCF"
+#define MPICOLL_CFG_VERSION 3
+
+/* writes an unsigned integer as a varint */
+static inline void mpicoll_cfg_write_uint(FILE *out, unsigned long value)
+{
+        do {
+                unsigned char byte = value & 0x7f;
+                value >>= 7;
+                if (value != 0) byte |= 0x80;
+                fputc(byte, out);
+        } while (value != 0);
+}
+
+/* writes a string as its length and its bytes */
+static inline void mpicoll_cfg_write_string(FILE *out, const char *str)
+{
+        size_t len = strlen(str);
+        mpicoll_cfg_write_uint(out, len);
+        fwrite(str, 1, len, out);
+}
+
+/* reads a varint from [*pos, end), returns 0 if the buffer is truncated */
+static inline int mpicoll_cfg_read_uint(const unsigned char **pos, const unsigned char *end, unsigned long *value)
+{
+        unsigned long result = 0;
+        int shift = 0;
+        while (*pos < end && shift < 64) {
+                unsigned char byte = *(*pos)++;
+                result |= (unsigned long) (byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                        *value = result;
+                        return 1;
+                }
+                shift += 7;
+        }
+        return 0;
+}
+
+#endif
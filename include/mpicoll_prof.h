@@ -0,0 +1,44 @@
+/* Layout of a profiled site, shared by -fplugin-arg-libplugin-profile=<site table> and src/mpicoll_prof.c */
+
+/* Every profiled function gets a static array with one site per collective, indexed by the order of
+ * the collectives in the function, placed in the section MPICOLL_PROF_SECTION with the id of each site
+ * already set. The runtime walks the section between the symbols the linker defines for it, nothing is
+ * registered at run time. The id is the first column of the site table.
+ *
+ * The plugin sees a site as MPICOLL_PROF_SITE_WORDS unsigned long long. A site is 576 bytes and an
+ * array is aligned on MPICOLL_PROF_SITE_ALIGN bytes, so the arrays of every object follow each other
+ * in the section without padding.
+ */
+
+#ifndef MPICOLL_PROF_H
+#define MPICOLL_PROF_H
+
+#define MPICOLL_PROF_BUCKETS 64
+#define MPICOLL_PROF_SECTION "mpicoll_prof_sites"
+#define MPICOLL_PROF_SITE_ALIGN 64
+
+struct mpicoll_prof_site {
+	unsigned long long id;
+	unsigned long long calls;
+	unsigned long long total;
+	unsigned long long max;
+	unsigned long long buckets[MPICOLL_PROF_BUCKETS];
+	unsigned long long padding[4];
+};
+
+#define MPICOLL_PROF_SITE_WORDS (sizeof(struct mpicoll_prof_site) / sizeof(unsigned long long))
+
+/* The probes read the time stamp counter inline, before and after the collective, the runtime
+ * converts the ticks to nanoseconds. Elsewhere they call mpicoll_prof_ticks(), in nanoseconds.
+ */
+#if defined(__x86_64__)
+#define MPICOLL_PROF_TICKS_ASM "rdtsc\n\tshlq\t$32, %%rdx\n\torq\t%%rdx, %0"
+#define MPICOLL_PROF_TICKS_OUTPUT "=a"
+#define MPICOLL_PROF_TICKS_CLOBBER "rdx"
+#elif defined(__aarch64__)
+#define MPICOLL_PROF_TICKS_ASM "isb\n\tmrs\t%0, cntvct_el0"
+#define MPICOLL_PROF_TICKS_OUTPUT "=r"
+#define MPICOLL_PROF_TICKS_CLOBBER "cc"
+#endif
+
+#endif
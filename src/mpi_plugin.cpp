@@ -10,43 +10,518 @@
 #include <vector>
 #include <diagnostic-core.h>
 #include <c-family/c-pragma.h>
+#include <timevar.h>
+#include <attribs.h>
+#include <ggc.h>
+#include <cfganal.h>
+#include <cgraph.h>
+#include <sys/mman.h>
+#include <gimple-walk.h>
+#include <tree-pretty-print.h>
+#include <string>
+#include <ssa.h>
+#include <tree-into-ssa.h>
+#include <cfgloop.h>
+#include <gimplify-me.h>
 
 /* Global variable required for plugin to execute */
 int plugin_is_GPL_compatible;
 
+/* Attributes of the entries of include/MPI_collectives.def */
+#define MPICOLL_BLOCKING        (1 << 0)
+#define MPICOLL_NONBLOCKING     (1 << 1)        /* started collective, completed by a wait on its request */
+#define MPICOLL_WAIT            (1 << 2)        /* completion of requests, not part of the matching of collectives */
+#define MPICOLL_REDUCTION       (1 << 3)
+#define MPICOLL_SYNCHRONIZING   (1 << 4)        /* no rank leaves it before every rank entered it */
+
 /* Enum to represent the collective operations */
 enum mpi_collective_code {
-#define DEFMPICOLLECTIVES( CODE, NAME ) CODE,
+#define DEFMPICOLLECTIVES( CODE, NAME, FLAGS, NONBLOCKING, COMM, SEND, RECV, COUNT, DATATYPE, OP, REQUEST ) CODE,
 #include "include/MPI_collectives.def"
         LAST_AND_UNUSED_MPI_COLLECTIVE_CODE
 #undef DEFMPICOLLECTIVES
 } ;
 
+#define MPICOLL_NO_CODE LAST_AND_UNUSED_MPI_COLLECTIVE_CODE
+
 /* Name of each MPI collective operations */
-#define DEFMPICOLLECTIVES( CODE, NAME ) NAME,
+#define DEFMPICOLLECTIVES( CODE, NAME, FLAGS, NONBLOCKING, COMM, SEND, RECV, COUNT, DATATYPE, OP, REQUEST ) NAME,
 const char *const mpi_collective_name[] = {
 #include "include/MPI_collectives.def"
 } ;
 #undef DEFMPICOLLECTIVES
 
+/* Attributes of each MPI collective operations */
+#define DEFMPICOLLECTIVES( CODE, NAME, FLAGS, NONBLOCKING, COMM, SEND, RECV, COUNT, DATATYPE, OP, REQUEST ) FLAGS,
+const int mpi_collective_flags[] = {
+#include "include/MPI_collectives.def"
+} ;
+#undef DEFMPICOLLECTIVES
+
+/* Non-blocking form of each blocking collective, MPICOLL_NO_CODE when there is none */
+#define DEFMPICOLLECTIVES( CODE, NAME, FLAGS, NONBLOCKING, COMM, SEND, RECV, COUNT, DATATYPE, OP, REQUEST ) NONBLOCKING,
+const int mpi_collective_nonblocking[] = {
+#include "include/MPI_collectives.def"
+} ;
+#undef DEFMPICOLLECTIVES
+
+/* Index of the arguments of each MPI collective operations, -1 when absent */
+struct mpi_collective_args {
+        int comm;
+        int send;
+        int recv;
+        int count;
+        int datatype;
+        int op;
+        int request;
+};
+
+#define DEFMPICOLLECTIVES( CODE, NAME, FLAGS, NONBLOCKING, COMM, SEND, RECV, COUNT, DATATYPE, OP, REQUEST ) \
+        { COMM, SEND, RECV, COUNT, DATATYPE, OP, REQUEST },
+const mpi_collective_args mpi_collective_arg[] = {
+#include "include/MPI_collectives.def"
+} ;
+#undef DEFMPICOLLECTIVES
+
+/* Enum to represent the phases of the analysis */
+enum mpicoll_phase {
+#define DEFMPICOLLPHASE( CODE, NAME, TIMER_NAME ) CODE,
+#include "include/mpicoll_phases.def"
+        LAST_AND_UNUSED_MPICOLL_PHASE
+#undef DEFMPICOLLPHASE
+} ;
+
+/* Name of each phase in the statistics file */
+#define DEFMPICOLLPHASE( CODE, NAME, TIMER_NAME ) NAME,
+const char *const mpicoll_phase_name[] = {
+#include "include/mpicoll_phases.def"
+} ;
+#undef DEFMPICOLLPHASE
+
+/* Name of the timer of each phase in -ftime-report */
+#define DEFMPICOLLPHASE( CODE, NAME, TIMER_NAME ) TIMER_NAME,
+const char *const mpicoll_phase_timer_name[] = {
+#include "include/mpicoll_phases.def"
+} ;
+#undef DEFMPICOLLPHASE
+
+#include "include/mpicoll_cfg.h"
+#include "include/mpicoll_prof.h"
+
+/* Statistics file given by -fplugin-arg-libplugin-stats=<file>, NULL when not requested */
+static FILE *stats_file;
+
+/* Time spent in each phase for the current function, in microseconds */
+static long phase_time[LAST_AND_UNUSED_MPICOLL_PHASE];
+static long phase_start_time;
+
+/* starts the timer of a phase of the analysis */
+static void phase_start(enum mpicoll_phase phase)
+{
+        if (g_timer) g_timer -> push_client_item(mpicoll_phase_timer_name[phase]);
+        if (stats_file) phase_start_time = get_run_time();
+}
+
+/* stops the timer of a phase of the analysis */
+static void phase_stop(enum mpicoll_phase phase)
+{
+        if (stats_file) phase_time[phase] += get_run_time() - phase_start_time;
+        if (g_timer) g_timer -> pop_client_item();
+}
+
+/* Pass placement */
+
+/* Passes after which the analysis runs, given by -fplugin-arg-libplugin-pass=<pass>[:<instance>] */
+/* the pass can be given several times, the analysis then runs once at each placement */
+struct mpicoll_placement {
+        const char *pass;
+        int instance;           /* 0 for every instance of the pass */
+};
+static std::vector <mpicoll_placement> placements;
+
+/* true during the run at the last placement given: the reports besides the warnings, the changes */
+/* of the code and the export are only done once, at the last placement */
+static bool final_run = true;
+
+/* true when the current run added or removed statements */
+static bool code_changed;
+
+/* Obstack holding the bitmaps and arrays of the analysis of the current function */
+/* it is created at the start of the pass execution and released in one shot at its end */
+static bitmap_obstack mpicoll_obstack;
+
+/* Collective code of every called function declaration already seen, keyed by DECL_UID */
+static hash_map<int_hash<unsigned int, UINT_MAX>, int> *decl_collective_code;
+
+/* returns the code of the entry of the table matching a called function declaration, waits included */
+/* the name matching is done once per declaration, later lookups hit the DECL_UID cache */
+int mpi_table_code_of_decl(tree function_decl) {
+        if (function_decl == NULL_TREE || DECL_NAME(function_decl) == NULL_TREE) return LAST_AND_UNUSED_MPI_COLLECTIVE_CODE;
+
+        if (decl_collective_code == NULL) decl_collective_code = new hash_map<int_hash<unsigned int, UINT_MAX>, int>;
+
+        int *cached = decl_collective_code -> get(DECL_UID(function_decl));
+        if (cached) return *cached;
+
+        int code = LAST_AND_UNUSED_MPI_COLLECTIVE_CODE;
+        const char* func_name = IDENTIFIER_POINTER(DECL_NAME(function_decl));
+        if (strncmp(func_name, "MPI_", 4) == 0) {
+                for (int i = 0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; ++i) {
+                        if (strcmp(func_name, mpi_collective_name[i]) == 0) {
+                                code = i;
+                                break;
+                        }
+                }
+        }
+        decl_collective_code -> put(DECL_UID(function_decl), code);
+        return code;
+}
+
+/* returns the collective code of a called function declaration, the waits are not collectives */
+int mpi_collective_code_of_decl(tree function_decl) {
+        int code = mpi_table_code_of_decl(function_decl);
+        if (code != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE && (mpi_collective_flags[code] & MPICOLL_WAIT)) return LAST_AND_UNUSED_MPI_COLLECTIVE_CODE;
+        return code;
+}
+
+/* Interprocedural summaries */
+
+/* Collectives executed by a call to a function of the translation unit */
+/* uniform is true when every path of the function executes the same sequence of collectives */
+/* complete is false while a callee of the function has no CFG yet, the summary is then computed again later */
+struct collective_summary {
+        bool uniform;
+        bool complete;
+        std::vector <int> sequence;
+        int counts[LAST_AND_UNUSED_MPI_COLLECTIVE_CODE];
+};
+
+/* values returned by collective_summary_of_decl when there is no summary */
+#define NO_SUMMARY (-1)                 /* the function is not defined in the translation unit */
+#define PENDING_SUMMARY (-2)            /* the function is defined but its CFG is not built yet */
+
+/* Summaries computed so far, each function is summarized once per translation unit */
+/* summary_index maps the DECL_UID of a function to the position of its summary in summaries */
+static hash_map<int_hash<unsigned int, UINT_MAX>, int> *summary_index;
+static std::vector <collective_summary *> summaries;
+
+int collective_summary_of_decl(tree function_decl);
+
+/* Summary files, one per object, to share the summaries between translation units */
+/* -fplugin-arg-libplugin-summary-out=<file> writes the summaries of the public functions of the unit */
+/* -fplugin-arg-libplugin-summary-in=<file> (repeatable) reads the summaries of functions defined elsewhere */
+#define SUMMARY_FILE_MAGIC "mpicoll-summary"
+#define SUMMARY_FILE_VERSION 1
+
+static const char *summary_out_file;
+
+/* Summaries read from the summary files, by function name, with their position in summaries */
+static hash_map<nofree_string_hash, int> *imported_summaries;
+
+/* reads a summary file, each line is: <function> uniform|divergent [<collective> ...] */
+/* returns false if the file cannot be read */
+static bool read_summary_file(const char *filename)
+{
+        FILE *in = fopen(filename, "r");
+        if (in == NULL) return false;
+
+        char *line = NULL;
+        size_t size = 0;
+        int version = 0;
+        char magic[32];
+
+        if (getline(&line, &size, in) == -1 || sscanf(line, "%31s %d", magic, &version) != 2
+            || strcmp(magic, SUMMARY_FILE_MAGIC) != 0 || version != SUMMARY_FILE_VERSION) {
+                warning(0, "ignoring summary file %s: not a version %d summary file", filename, SUMMARY_FILE_VERSION);
+                free(line);
+                fclose(in);
+                return true;
+        }
+
+        if (imported_summaries == NULL) imported_summaries = new hash_map<nofree_string_hash, int>;
+
+        while (getline(&line, &size, in) != -1) {
+                char *name = strtok(line, " \t\n");
+                char *kind = strtok(NULL, " \t\n");
+                if (name == NULL || kind == NULL) continue;
+
+                collective_summary *summary = new collective_summary;
+                summary -> uniform = strcmp(kind, "uniform") == 0;
+                summary -> complete = true;
+                memset(summary -> counts, 0, sizeof(summary -> counts));
+
+                for (char *coll = strtok(NULL, " \t\n"); coll != NULL && summary -> uniform; coll = strtok(NULL, " \t\n")) {
+                        int c = 0;
+                        while (c < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE && strcmp(coll, mpi_collective_name[c]) != 0) c++;
+                        /* a collective unknown to this version of the table makes the sequence unusable */
+                        if (c == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) summary -> uniform = false;
+                        else {
+                                summary -> sequence.push_back(c);
+                                summary -> counts[c]++;
+                        }
+                }
+                if (!summary -> uniform) {
+                        summary -> sequence.clear();
+                        memset(summary -> counts, 0, sizeof(summary -> counts));
+                }
+
+                /* a function summarized by several files keeps its sequence only when they agree */
+                int *previous = imported_summaries -> get(name);
+                if (previous != NULL) {
+                        collective_summary *first = summaries[*previous];
+                        bool same = first -> uniform == summary -> uniform && first -> sequence == summary -> sequence;
+                        warning(0, "function %s summarized again in %s%s", name, filename, same ? "" : " with another sequence, it is taken as divergent");
+                        if (!same) {
+                                first -> uniform = false;
+                                first -> sequence.clear();
+                                memset(first -> counts, 0, sizeof(first -> counts));
+                        }
+                        delete summary;
+                        continue;
+                }
+
+                imported_summaries -> put(xstrdup(name), summaries.size());
+                summaries.push_back(summary);
+        }
+
+        free(line);
+        fclose(in);
+        return true;
+}
+
+/* returns the position of the summary read from the summary files for an external function, NO_SUMMARY if none */
+static int imported_summary_of_decl(tree function_decl)
+{
+        if (imported_summaries == NULL || !TREE_PUBLIC(function_decl) || DECL_NAME(function_decl) == NULL_TREE) return NO_SUMMARY;
+        int *index = imported_summaries -> get(IDENTIFIER_POINTER(DECL_NAME(function_decl)));
+        return index ? *index : NO_SUMMARY;
+}
+
+/* writes the summaries of the public functions defined in the translation unit */
+/* called once every function has a CFG, the summaries already computed for the analysis are reused */
+void write_summary_file(void *event_data, void *data)
+{
+        FILE *out = fopen(summary_out_file, "w");
+        if (out == NULL) {
+                error("cannot open summary file %s: %m", summary_out_file);
+                return;
+        }
+        fprintf(out, "%s %d\n", SUMMARY_FILE_MAGIC, SUMMARY_FILE_VERSION);
+
+        cgraph_node *node;
+        FOR_EACH_FUNCTION_WITH_GIMPLE_BODY(node) {
+                tree decl = node -> decl;
+                if (!TREE_PUBLIC(decl) || DECL_NAME(decl) == NULL_TREE) continue;
+
+                int s = collective_summary_of_decl(decl);
+                if (s < 0) continue;
+
+                fprintf(out, "%s %s", IDENTIFIER_POINTER(DECL_NAME(decl)), summaries[s] -> uniform ? "uniform" : "divergent");
+                for (size_t k = 0; k < summaries[s] -> sequence.size(); k++) {
+                        fprintf(out, " %s", mpi_collective_name[summaries[s] -> sequence[k]]);
+                }
+                fprintf(out, "\n");
+        }
+        fclose(out);
+}
+
+/* computes the summary of the function, returns false if a callee has no CFG yet */
+/* the collectives form a uniform sequence when every block containing one post-dominates */
+/* the first block and is not on a cycle, the sequence is then the post-dominator chain of the first block */
+static bool compute_collective_summary(function *fn, collective_summary *summary)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+        bool complete = true;
+        bool uniform = true;
+        int nb_collective_blocks = 0;
+
+        push_cfun(fn);
+
+        /* collectives executed by each block, in order */
+        std::vector <std::vector<int> > block_sequence(last_basic_block_for_fn(fn));
+
+        FOR_EACH_BB_FN(bb, fn) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        if (!is_gimple_call(stmt)) continue;
+
+                        tree callee = gimple_call_fndecl(stmt);
+                        int c = mpi_collective_code_of_decl(callee);
+                        if (c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) {
+                                block_sequence[bb -> index].push_back(c);
+                                continue;
+                        }
+                        int s = collective_summary_of_decl(callee);
+                        if (s == PENDING_SUMMARY) complete = false;
+                        else if (s != NO_SUMMARY) {
+                                /* the summary of a function being summarized (recursion) is not uniform */
+                                if (!summaries[s] -> uniform) uniform = false;
+                                block_sequence[bb -> index].insert(block_sequence[bb -> index].end(),
+                                                summaries[s] -> sequence.begin(), summaries[s] -> sequence.end());
+                        }
+                }
+                if (!block_sequence[bb -> index].empty()) nb_collective_blocks++;
+        }
+
+        summary -> sequence.clear();
+        if (complete && uniform && nb_collective_blocks != 0) {
+                bool computed = !dom_info_available_p(CDI_POST_DOMINATORS);
+                if (computed) calculate_dominance_info(CDI_POST_DOMINATORS);
+
+                /* the blocks of a cycle reach the source of its back edge without going through its destination */
+                bitmap_head in_cycle;
+                bitmap_initialize(&in_cycle, &bitmap_default_obstack);
+                if (mark_dfs_back_edges(fn)) {
+                        FOR_ALL_BB_FN(bb, fn) {
+                                edge e;
+                                edge_iterator it;
+                                FOR_EACH_EDGE(e, it, bb -> succs) {
+                                        if (!(e -> flags & EDGE_DFS_BACK)) continue;
+                                        std::vector <basic_block> to_visit;
+                                        bitmap_set_bit(&in_cycle, e -> dest -> index);
+                                        if (bitmap_set_bit(&in_cycle, bb -> index)) to_visit.push_back(bb);
+                                        while (to_visit.size() != 0) {
+                                                basic_block b = to_visit.back();
+                                                to_visit.pop_back();
+                                                edge pe;
+                                                edge_iterator pit;
+                                                FOR_EACH_EDGE(pe, pit, b -> preds) {
+                                                        if (bitmap_set_bit(&in_cycle, pe -> src -> index)) to_visit.push_back(pe -> src);
+                                                }
+                                        }
+                                }
+                        }
+                }
+
+                int on_chain = 0;
+                basic_block last = EXIT_BLOCK_PTR_FOR_FN(fn);
+                for (bb = single_succ(ENTRY_BLOCK_PTR_FOR_FN(fn)); bb != NULL && bb != last;
+                     bb = get_immediate_dominator(CDI_POST_DOMINATORS, bb)) {
+                        if (block_sequence[bb -> index].empty()) continue;
+                        if (bitmap_bit_p(&in_cycle, bb -> index)) break;
+                        on_chain++;
+                        summary -> sequence.insert(summary -> sequence.end(),
+                                        block_sequence[bb -> index].begin(), block_sequence[bb -> index].end());
+                }
+                uniform = on_chain == nb_collective_blocks;
+
+                bitmap_clear(&in_cycle);
+                if (computed) free_dominance_info(CDI_POST_DOMINATORS);
+        }
+        if (!uniform) summary -> sequence.clear();
+
+        summary -> uniform = uniform;
+        memset(summary -> counts, 0, sizeof(summary -> counts));
+        for (size_t k = 0; k < summary -> sequence.size(); k++) summary -> counts[summary -> sequence[k]]++;
+
+        pop_cfun();
+        return complete;
+}
+
+/* returns the position of the summary of a called function in summaries, NO_SUMMARY or PENDING_SUMMARY */
+/* a function is summarized once, later calls hit the DECL_UID map */
+int collective_summary_of_decl(tree function_decl)
+{
+        if (function_decl == NULL_TREE) return NO_SUMMARY;
+
+        if (summary_index == NULL) summary_index = new hash_map<int_hash<unsigned int, UINT_MAX>, int>;
+
+        int *cached = summary_index -> get(DECL_UID(function_decl));
+        if (cached && summaries[*cached] -> complete) return *cached;
+
+        /* a function of another translation unit can only have the summary read from its summary file */
+        function *fn = DECL_STRUCT_FUNCTION(function_decl);
+        if (fn == NULL) {
+                int s = imported_summary_of_decl(function_decl);
+                if (s != NO_SUMMARY) summary_index -> put(DECL_UID(function_decl), s);
+                return s;
+        }
+        if (fn -> cfg == NULL) return PENDING_SUMMARY;
+
+        int index;
+        if (cached) index = *cached;
+        else {
+                index = summaries.size();
+                summaries.push_back(new collective_summary);
+                summary_index -> put(DECL_UID(function_decl), index);
+        }
+        /* until it is computed, a recursive call sees a complete but not uniform summary */
+        collective_summary *summary = summaries[index];
+        summary -> uniform = false;
+        summary -> complete = true;
+        summary -> sequence.clear();
+
+        summary -> complete = compute_collective_summary(fn, summary);
+
+	#ifdef DEBUG
+        printf("[SUMMARY] %s: %s%s", fndecl_name(function_decl),
+                        summary -> complete ? "" : "pending, ", summary -> uniform ? "uniform [" : "not uniform [");
+        for (size_t k = 0; k < summary -> sequence.size(); k++) printf("%s%s", k ? ", " : "", mpi_collective_name[summary -> sequence[k]]);
+        printf("]\n");
+	#endif
+        if (!summary -> complete) return PENDING_SUMMARY;
+        return index;
+}
+
+/* classifies every statement of the function once and stores the result in its uid */
+/* the uid is the collective code + 1 for a collective, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE + 1 + the */
+/* position of the summary for a call to a function executing a uniform sequence of collectives, and 0 otherwise */
+/* pending is set when a called function has no CFG yet */
+/* returns the number of collectives executed by the function's calls */
+int classify_mpi_calls(function *fun, bool *pending)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+        int nb_collectives = 0;
+
+        FOR_ALL_BB_FN(bb, fun)
+        {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi))
+                {
+                        gimple *stmt = gsi_stmt(gsi);
+                        unsigned int uid = 0;
+
+                        if (is_gimple_call(stmt)) {
+                                tree callee = gimple_call_fndecl(stmt);
+                                int c = mpi_collective_code_of_decl(callee);
+                                if (c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) {
+                                        uid = c + 1;
+                                        nb_collectives++;
+                                }
+                                else {
+                                        int s = collective_summary_of_decl(callee);
+                                        if (s == PENDING_SUMMARY) *pending = true;
+                                        else if (s != NO_SUMMARY && summaries[s] -> sequence.size() != 0) {
+                                                uid = LAST_AND_UNUSED_MPI_COLLECTIVE_CODE + 1 + s;
+                                                nb_collectives += summaries[s] -> sequence.size();
+                                        }
+                                }
+                        }
+                        gimple_set_uid(stmt, uid);
+                }
+        }
+        return nb_collectives;
+}
+
 /* Check if the statement is one of the mpi collectives and returns its code */
+/* relies on the classification done by classify_mpi_calls */
 int is_mpi_call(gimple *stmt) {
-        if (is_gimple_call(stmt)) {
-        tree function_decl = gimple_call_fndecl(stmt);
-        const char* func_name = get_name(function_decl);
-	if (strncmp(func_name, "MPI_", 4) == 0) {
-        	for (int i = 0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; ++i) {
-                	if (strcmp(func_name, mpi_collective_name[i]) == 0) {
-         	                return i;
-                	}
-            	}
-        }
-        
-    }
-    return LAST_AND_UNUSED_MPI_COLLECTIVE_CODE;
+        unsigned int uid = gimple_uid(stmt);
+        if (uid != 0 && uid <= LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) return uid - 1;
+        return LAST_AND_UNUSED_MPI_COLLECTIVE_CODE;
+}
+
+/* returns the summary of the function called by the statement, NULL if it is not a summarized call */
+/* relies on the classification done by classify_mpi_calls */
+collective_summary *summary_of_call(gimple *stmt) {
+        unsigned int uid = gimple_uid(stmt);
+        if (uid <= LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) return NULL;
+        return summaries[uid - LAST_AND_UNUSED_MPI_COLLECTIVE_CODE - 1];
 }
 
-/* returns the number of mpi collectives in the basic block  */
+/* returns the number of statements executing collectives in the basic block */
+/* a call to a summarized function counts as one statement */
 int get_nb_mpi_calls_in_bb( basic_block bb )
 {
         gimple_stmt_iterator gsi;
@@ -56,9 +531,7 @@ int get_nb_mpi_calls_in_bb( basic_block bb )
         {
                 gimple *stmt = gsi_stmt (gsi);
 
-                int c = is_mpi_call(stmt) ;
-
-                if ( c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE )
+                if ( gimple_uid(stmt) != 0 )
                 {
                         nb_mpi_coll++ ;
                 }
@@ -83,9 +556,7 @@ void split_multiple_mpi_calls( function * fun )
                         {
                                 gimple *stmt = gsi_stmt (gsi);
 
-                                int c = is_mpi_call(stmt) ;
-
-                                if ( c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE )
+                                if ( gimple_uid(stmt) != 0 )
                                 {
                                         split_block( bb, stmt ) ;
                                 }
@@ -94,61 +565,255 @@ void split_multiple_mpi_calls( function * fun )
         }
 }
 
-/* struct used to store the collective code in the block */
-/* and a vector to store the ranks of the collectives in that block */
-typedef struct {
-	int code;
-	int* ranks;
-} mpi_ranks;
+/* Communicators */
+
+/* Definitions of the variables of the current function holding a communicator: the value of the single */
+/* assignment of a variable, error_mark_node when it is assigned several times or when its address escapes */
+/* a variable that is not in the map is only written by the MPI routines given its address, listed in comm_outputs */
+static hash_map<tree, tree> *comm_definitions;
+static hash_set<tree> *comm_outputs;
+
+/* the address of a variable given to anything but an MPI routine lets it be changed behind our back */
+static bool comm_visit_addr(gimple *stmt, tree base, tree op, void *data)
+{
+        if (DECL_P(base)) comm_definitions -> put(base, error_mark_node);
+        return false;
+}
+
+static bool comm_visit_output(gimple *stmt, tree base, tree op, void *data)
+{
+        if (DECL_P(base)) comm_outputs -> add(base);
+        return false;
+}
+
+/* records the assignments of the local variables of the function */
+static void collect_comm_definitions(function *fun)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+
+        if (comm_definitions == NULL) comm_definitions = new hash_map<tree, tree>;
+        if (comm_outputs == NULL) comm_outputs = new hash_set<tree>;
+        comm_definitions -> empty();
+        comm_outputs -> empty();
+
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        if (is_gimple_assign(stmt) && DECL_P(gimple_assign_lhs(stmt))) {
+                                tree lhs = gimple_assign_lhs(stmt);
+                                bool copy = gimple_assign_single_p(stmt) && comm_definitions -> get(lhs) == NULL;
+                                comm_definitions -> put(lhs, copy ? gimple_assign_rhs1(stmt) : error_mark_node);
+                        }
+                        bool mpi_routine = is_gimple_call(stmt) && gimple_call_fndecl(stmt) != NULL_TREE
+                                && DECL_NAME(gimple_call_fndecl(stmt)) != NULL_TREE
+                                && strncmp(IDENTIFIER_POINTER(DECL_NAME(gimple_call_fndecl(stmt))), "MPI_", 4) == 0;
+                        walk_stmt_load_store_addr_ops(stmt, NULL, NULL, NULL, mpi_routine ? comm_visit_output : comm_visit_addr);
+                }
+        }
+}
+
+/* returns the communicator given to a collective: a constant, the address of a global object */
+/* (the predefined communicators) or a local variable only written by MPI routines */
+/* returns NULL_TREE when the communicator is unknown: a parameter, a global variable, a copy of several values */
+static tree communicator_of_collective(gimple *stmt, int code)
+{
+        int index = mpi_collective_arg[code].comm;
+        if (index < 0 || (unsigned) index >= gimple_call_num_args(stmt)) return NULL_TREE;
+
+        tree comm = gimple_call_arg(stmt, index);
+        /* the temporaries of the gimplification are followed to the variable they were loaded from */
+        for (int depth = 0; depth < 8; depth++) {
+                if (TREE_CODE(comm) == INTEGER_CST) return comm;
+                if (TREE_CODE(comm) == SSA_NAME) {
+                        gimple *def = SSA_NAME_DEF_STMT(comm);
+                        if (!is_gimple_assign(def) || !gimple_assign_single_p(def)) return NULL_TREE;
+                        comm = gimple_assign_rhs1(def);
+                        continue;
+                }
+                if (TREE_CODE(comm) == ADDR_EXPR) {
+                        tree base = get_base_address(TREE_OPERAND(comm, 0));
+                        return base != NULL_TREE && DECL_P(base) && is_global_var(base) ? comm : NULL_TREE;
+                }
+                if (TREE_CODE(comm) != VAR_DECL || is_global_var(comm)) return NULL_TREE;
+
+                /* a variable both assigned and written by an MPI routine may hold either communicator */
+                tree *definition = comm_definitions -> get(comm);
+                if (definition == NULL) return comm;
+                if (*definition == error_mark_node || comm_outputs -> contains(comm)) return NULL_TREE;
+                comm = *definition;
+        }
+        return NULL_TREE;
+}
+
+/* Classes of the collectives of the current function, the sets are built for each class */
+/* a class is a collective code and a communicator, the collectives on different communicators never match */
+/* when a collective of a code has an unknown communicator, every collective of that code is in one class */
+/* whose communicator is unknown, as before the communicators were told apart */
+struct collective_class {
+        int code;
+        tree comm;              /* NULL_TREE for an unknown communicator or a collective without one */
+};
+static std::vector <collective_class> collective_classes;
+static int nb_collective_classes;
+
+/* returns the class of a collective of the current function */
+static int class_of_collective(gimple *stmt, int code)
+{
+        tree comm = communicator_of_collective(stmt, code);
+        int unknown = -1;
+        for (int i=0; i < nb_collective_classes; i++) {
+                if (collective_classes[i].code != code) continue;
+                if (collective_classes[i].comm == NULL_TREE) unknown = i;
+                else if (comm != NULL_TREE && operand_equal_p(collective_classes[i].comm, comm, 0)) return i;
+        }
+        return unknown;
+}
+
+/* returns the class of the collectives of a code executed by summarized functions */
+/* the communicators used inside a called function are not known */
+static int class_of_code(int code)
+{
+        for (int i=0; i < nb_collective_classes; i++) {
+                if (collective_classes[i].code == code && collective_classes[i].comm == NULL_TREE) return i;
+        }
+        return -1;
+}
 
-void clean_aux_field( function * fun, long val )
+/* builds the classes of the collectives of the current function */
+void compute_collective_classes(function *fun)
 {
         basic_block bb;
+        gimple_stmt_iterator gsi;
+        bool unknown[LAST_AND_UNUSED_MPI_COLLECTIVE_CODE];
+        memset(unknown, 0, sizeof(unknown));
+
+        collect_comm_definitions(fun);
+        collective_classes.clear();
+
+        /* first pass: the codes having a collective on an unknown communicator */
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        int c = is_mpi_call(stmt);
+                        if (c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE && communicator_of_collective(stmt, c) == NULL_TREE) unknown[c] = true;
+                        collective_summary *summary = summary_of_call(stmt);
+                        if (summary != NULL) {
+                                for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+                                        if (summary -> counts[i] != 0) unknown[i] = true;
+                                }
+                        }
+                }
+        }
+        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+                if (unknown[i]) {
+                        collective_class c = { i, NULL_TREE };
+                        collective_classes.push_back(c);
+                }
+        }
 
-        /* Traverse all BBs to clean 'aux' field */
-        FOR_ALL_BB_FN (bb, fun)
-        {       
-		mpi_ranks *aux_rank = (mpi_ranks *) bb -> aux;
-		free(aux_rank -> ranks);
-		free(aux_rank);
-                bb->aux = (void *)val ;
+        /* second pass: one class per communicator for the other codes */
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        int c = is_mpi_call(stmt);
+                        if (c == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE || unknown[c]) continue;
+                        nb_collective_classes = collective_classes.size();
+                        if (class_of_collective(stmt, c) < 0) {
+                                collective_class cl = { c, communicator_of_collective(stmt, c) };
+                                collective_classes.push_back(cl);
+                        }
+                }
+        }
+        nb_collective_classes = collective_classes.size();
+
+        #ifdef DEBUG
+        printf("----------------- collective classes ------------------------\n");
+        for (int i=0; i < nb_collective_classes; i++) {
+                printf("class %d: %s on ", i, mpi_collective_name[collective_classes[i].code]);
+                if (collective_classes[i].comm == NULL_TREE) printf("unknown communicator");
+                else print_generic_expr(stdout, collective_classes[i].comm);
+                printf("\n");
         }
+        #endif
+}
+
+/* Ranks of the current function, stored in flat arrays indexed by block index */
+/* block_counts is a matrix of one row per block and one column per class holding the number of */
+/* collectives of each class executed by the block, it is 1 at most unless the block calls a summarized function */
+/* block_ranks has the same layout and holds the rank of each class at the end of the block */
+static int *block_counts;
+static int *block_ranks;
+
+/* returns the row of block_ranks holding the ranks of the collectives in the block */
+static inline int *ranks_of_block(int index)
+{
+        return &block_ranks[index * nb_collective_classes];
+}
+
+/* returns the row of block_counts holding the number of collectives executed by the block */
+static inline int *counts_of_block(int index)
+{
+        return &block_counts[index * nb_collective_classes];
 }
 
+/* returns true if the block executes at least one collective */
+static bool block_has_collective(int index)
+{
+        int *counts = counts_of_block(index);
+        for (int i=0; i < nb_collective_classes; i++) {
+                if (counts[i] != 0) return true;
+        }
+        return false;
+}
 
-/* function to initialize the mpi_ranks and store them in the aux field of the blocks */
-void mpi_ranks_in_aux(function *fun)
+/* function to initialize the collective counts and the ranks of the blocks */
+void init_block_ranks(function *fun)
 {
         basic_block bb;
         gimple_stmt_iterator gsi;
         gimple *stmt;
 
+        compute_collective_classes(fun);
+
+        int nb_blocks = last_basic_block_for_fn(fun);
+        block_counts = XOBNEWVEC(&mpicoll_obstack.obstack, int, nb_blocks * nb_collective_classes);
+        block_ranks = XOBNEWVEC(&mpicoll_obstack.obstack, int, nb_blocks * nb_collective_classes);
+        memset(block_counts, 0, nb_blocks * nb_collective_classes * sizeof(int));
+        memset(block_ranks, 0, nb_blocks * nb_collective_classes * sizeof(int));
+
         FOR_ALL_BB_FN(bb,fun)
         {	
-		mpi_ranks *aux_ranks = XNEWVEC(mpi_ranks, 1);
-		int *ranks = XNEWVEC(int, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE);
-		
-		for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) ranks[i]=0;
-		
-		aux_ranks -> ranks = ranks;
-		aux_ranks -> code = LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; /* default value when there is no collective  */
-		
+                int *counts = counts_of_block(bb -> index);
                 for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi))
                 {
                         stmt = gsi_stmt(gsi);
 
                         int c = is_mpi_call(stmt);
-			if (c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) aux_ranks -> code = c;
+			if (c != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) counts[class_of_collective(stmt, c)]++;
+
+                        collective_summary *summary = summary_of_call(stmt);
+                        if (summary != NULL) {
+                                for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+                                        if (summary -> counts[i] != 0) counts[class_of_code(i)] += summary -> counts[i];
+                                }
+                        }
                 }
-		bb -> aux = aux_ranks;
         }
 }
 
 void prepare_cfg(function * fun)
 {
+        /* split_block does not update the post-dominators, they are computed again after the split */
+        free_dominance_info(CDI_POST_DOMINATORS);
+
+        phase_start(PHASE_SPLIT);
         split_multiple_mpi_calls(fun);
+        phase_stop(PHASE_SPLIT);
 
-        mpi_ranks_in_aux(fun);
+        phase_start(PHASE_BLOCK_RANKS);
+        init_block_ranks(fun);
+        phase_stop(PHASE_BLOCK_RANKS);
 }
 
 /* function to calculate the post dominance frontier of each basic_block and return it in bitmaps*/
@@ -158,9 +823,9 @@ bitmap_head *post_dominance_frontiers(function * fun)
         
         bitmap_head *frontiers;
         
-        frontiers = XNEWVEC (bitmap_head, last_basic_block_for_fn(cfun));
+        frontiers = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, last_basic_block_for_fn(cfun));
         FOR_ALL_BB_FN(bb, fun) {
-                bitmap_initialize(&frontiers[bb -> index], &bitmap_default_obstack);
+                bitmap_initialize(&frontiers[bb -> index], &mpicoll_obstack);
         }
         
         FOR_ALL_BB_FN(bb, fun) {
@@ -193,47 +858,55 @@ bitmap_head *post_dominance_frontiers(function * fun)
 }
 
 /* function to get the edges of loops going back */
+/* a single depth first search marks the edges going to a block that is still on the DFS path */
 bitmap_head *cfg_prime(function *fun) {
         basic_block bb;
 
         bitmap_head *invalid_edges;
-        bitmap_head *visited;
+        bitmap_head visited;
+        bitmap_head on_path; /* blocks between the entry and the current block of the DFS */
 
-        invalid_edges = XNEWVEC(bitmap_head, last_basic_block_for_fn(cfun));
-        visited = XNEWVEC(bitmap_head, last_basic_block_for_fn(cfun)); /* used to get the visited block to get to a certain block  */
+        invalid_edges = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, last_basic_block_for_fn(cfun));
         FOR_ALL_BB_FN(bb, fun) {
-                bitmap_initialize(&invalid_edges[bb -> index], &bitmap_default_obstack);
-                bitmap_initialize(&visited[bb -> index], &bitmap_default_obstack);
+                bitmap_initialize(&invalid_edges[bb -> index], &mpicoll_obstack);
         }
+        bitmap_initialize(&visited, &mpicoll_obstack);
+        bitmap_initialize(&on_path, &mpicoll_obstack);
 
-        std::vector <basic_block> to_visit;
-        to_visit.push_back(ENTRY_BLOCK_PTR_FOR_FN(fun));
+        /* each element is a block of the DFS path and the next successor edge to explore */
+        std::vector <std::pair<basic_block, edge_iterator> > to_visit;
+
+        bb = ENTRY_BLOCK_PTR_FOR_FN(fun);
+        bitmap_set_bit(&visited, bb -> index);
+        bitmap_set_bit(&on_path, bb -> index);
+        to_visit.push_back(std::make_pair(bb, ei_start(bb -> succs)));
 
         while (to_visit.size() != 0) {
-                bb = to_visit.back();
-                to_visit.pop_back();
-                int index = bb -> index;
-                bitmap_set_bit(&visited[index], index);
+                bb = to_visit.back().first;
+                edge_iterator it = to_visit.back().second;
 
-                edge_iterator it;
-                edge e;
+                if (ei_end_p(it)) {
+                        bitmap_clear_bit(&on_path, bb -> index);
+                        to_visit.pop_back();
+                        continue;
+                }
 
-                int edge_index = 0;
+                edge e = ei_edge(it);
+                int edge_index = it.index;
+                ei_next(&to_visit.back().second);
 
-                FOR_EACH_EDGE(e, it, bb -> succs) {
-                        basic_block child = e -> dest;
-                        if (bitmap_bit_p(&visited[index], child -> index)) {
-                                bitmap_set_bit(&invalid_edges[index], edge_index);
-                        }
-                        else {
-                                to_visit.push_back(child);
-                                bitmap_ior_into(&visited[child -> index], &visited[index]); /*transmit the visited blocks to the next */
-                        }
-                        edge_index++;
+                basic_block child = e -> dest;
+                if (bitmap_bit_p(&on_path, child -> index)) {
+                        bitmap_set_bit(&invalid_edges[bb -> index], edge_index);
+                }
+                else if (bitmap_set_bit(&visited, child -> index)) {
+                        bitmap_set_bit(&on_path, child -> index);
+                        to_visit.push_back(std::make_pair(child, ei_start(child -> succs)));
                 }
         }
 
-	BITMAP_FREE(visited);
+        bitmap_clear(&visited);
+        bitmap_clear(&on_path);
 
 	#ifdef DEBUG
         printf("----------------- invalid edges ------------------------\n");
@@ -247,51 +920,103 @@ bitmap_head *cfg_prime(function *fun) {
         return invalid_edges;
 }
 
-/* function to calculate the rank of each collective in each block
-and store the max rank of each collective in the last block  */
-void calculate_rank( function *fun, bitmap invalid_edges) {
+/* returns the blocks reachable from the entry in post-order of the CFG without its invalid edges */
+/* that graph is acyclic, so in reverse post-order every block comes after all of its predecessors */
+std::vector <basic_block> cfg_prime_post_order(function *fun, bitmap invalid_edges) {
         basic_block bb;
-        
-        std::vector <basic_block> to_visit;
-        to_visit.push_back(ENTRY_BLOCK_PTR_FOR_FN(fun));
-		
-	basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
-        mpi_ranks *last_aux_ranks = (mpi_ranks *) last -> aux;
-        int *last_ranks = last_aux_ranks -> ranks;
-        while (to_visit.size() != 0) {
-                bb = to_visit.front();
-                to_visit.erase(to_visit.begin());
 
+        std::vector <basic_block> post_order;
+        bitmap_head visited;
+        bitmap_initialize(&visited, &mpicoll_obstack);
 
-                int index = bb -> index;
+        std::vector <std::pair<basic_block, edge_iterator> > to_visit;
 
-                edge_iterator it;
-                edge e;
+        bb = ENTRY_BLOCK_PTR_FOR_FN(fun);
+        bitmap_set_bit(&visited, bb -> index);
+        to_visit.push_back(std::make_pair(bb, ei_start(bb -> succs)));
 
-                int edge_index = 0;
+        while (to_visit.size() != 0) {
+                bb = to_visit.back().first;
+                edge_iterator it = to_visit.back().second;
 
-                mpi_ranks *father_aux_ranks = (mpi_ranks *) bb -> aux;
+                if (ei_end_p(it)) {
+                        post_order.push_back(bb);
+                        to_visit.pop_back();
+                        continue;
+                }
 
-                FOR_EACH_EDGE(e, it, bb -> succs) {
+                edge e = ei_edge(it);
+                int edge_index = it.index;
+                ei_next(&to_visit.back().second);
+
+                if (bitmap_bit_p(&invalid_edges[bb -> index], edge_index)) continue;
+
+                basic_block child = e -> dest;
+                if (bitmap_set_bit(&visited, child -> index)) {
+                        to_visit.push_back(std::make_pair(child, ei_start(child -> succs)));
+                }
+        }
+
+        bitmap_clear(&visited);
+        return post_order;
+}
+
+/* returns true when no warning is possible: the CFG has no back edge and every block containing */
+/* a collective post-dominates the entry, so every path executes the same sequence of collectives */
+bool collectives_on_every_path(function *fun, bitmap invalid_edges)
+{
+        basic_block bb;
+        basic_block first = single_succ(ENTRY_BLOCK_PTR_FOR_FN(fun));
+
+        FOR_ALL_BB_FN(bb, fun) {
+                if (!bitmap_empty_p(&invalid_edges[bb -> index])) return false;
+        }
+        FOR_EACH_BB_FN(bb, fun) {
+                if (block_has_collective(bb -> index)
+                    && !dominated_by_p(CDI_POST_DOMINATORS, first, bb)) return false;
+        }
+        return true;
+}
+
+/* function to calculate the rank of each collective in each block
+and store the max rank of each collective in the last block  */
+/* blocks are visited once, in reverse post-order of the CFG without its invalid edges */
+void calculate_rank( function *fun, bitmap invalid_edges) {
+        basic_block bb;
+        
+        std::vector <basic_block> post_order = cfg_prime_post_order(fun, invalid_edges);
+		
+	basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
+        int *last_ranks = ranks_of_block(last -> index);
+        for (int n = post_order.size() - 1; n >= 0; n--) {
+                bb = post_order[n];
+
+                int index = bb -> index;
+
+                edge_iterator it;
+                edge e;
+
+                int edge_index = 0;
+
+                int* father_ranks = ranks_of_block(index);
+
+                FOR_EACH_EDGE(e, it, bb -> succs) {
 			basic_block child = e -> dest;
-                        mpi_ranks *child_aux_ranks = (mpi_ranks *) child -> aux;
-                        int* father_ranks = father_aux_ranks -> ranks;
-                        int* child_ranks = child_aux_ranks -> ranks;
+                        int* child_ranks = ranks_of_block(child -> index);
+                        int* child_counts = counts_of_block(child -> index);
                         if (!bitmap_bit_p(&invalid_edges[index], edge_index)) {
-                                for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
-                                        if (father_ranks[i] >= child_ranks[i]) {
-                                                child_ranks[i] = father_ranks[i];
-                                                if (i == child_aux_ranks -> code) child_ranks[i] += 1;
+                                for (int i=0; i < nb_collective_classes; i++) {
+                                        if (father_ranks[i] + child_counts[i] > child_ranks[i]) {
+                                                child_ranks[i] = father_ranks[i] + child_counts[i];
                                         }
                                 }
-                                to_visit.push_back(child);
                         }
 			else {
 				//since we do not transmit the ranks through looping edges
 				//we check if the ranks in this block are superior to the ranks in the last
 				//this way we ensure that the last block contains the max rank for each collective
 				//this will be usefule to create the sets and iterate over them
-				for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+				for (int i=0; i < nb_collective_classes; i++) {
                  		       if (father_ranks[i] > last_ranks[i]) last_ranks[i] = father_ranks[i];
                 		}
 			}
@@ -301,10 +1026,10 @@ void calculate_rank( function *fun, bitmap invalid_edges) {
 	#ifdef DEBUG
         FOR_ALL_BB_FN(bb, fun) {
                	printf("index: %2d - ", bb -> index);
-               	mpi_ranks *aux_ranks = (mpi_ranks *) bb -> aux;
-               	printf("collective: %d - ", aux_ranks -> code);
-               	printf("[");
-               	for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) printf("%d, ", (aux_ranks -> ranks)[i]);
+               	printf("collectives: [");
+               	for (int i=0; i < nb_collective_classes; i++) printf("%d, ", counts_of_block(bb -> index)[i]);
+               	printf("] - [");
+               	for (int i=0; i < nb_collective_classes; i++) printf("%d, ", ranks_of_block(bb -> index)[i]);
                	printf("]\n");
        	}
 	#endif
@@ -313,42 +1038,41 @@ void calculate_rank( function *fun, bitmap invalid_edges) {
 /* returns a matrix of bitmaps representing the blocks containing a collective of a certain rank */
 bitmap_head** collective_rank_set(function *fun) {
         basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
-        mpi_ranks *aux_ranks = (mpi_ranks *) last -> aux;
+        int *ranks = ranks_of_block(last -> index); /* ranks in the last block containing the max ranks */
 
-        int *ranks = aux_ranks -> ranks; /* ranks in the last block containing the max ranks */
-
-        bitmap_head **sets = XNEWVEC(bitmap_head*, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE);
-	/* coordinates i, j are the collective code and the rank */
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+        bitmap_head **sets = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head*, nb_collective_classes);
+	/* coordinates i, j are the class of the collective and the rank */
+        for (int i=0; i < nb_collective_classes; i++) {
                 int max_rank = ranks[i]; /* getting the max rank for this collective to create enough bitmaps */
                 if (max_rank != 0) {
-                        sets[i] = XNEWVEC(bitmap_head, max_rank);
+                        sets[i] = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, max_rank);
                         for(int j=0; j < max_rank; j++) {
-                                bitmap_initialize(&sets[i][j], &bitmap_default_obstack);
+                                bitmap_initialize(&sets[i][j], &mpicoll_obstack);
                         }
                 }
         }
 
         basic_block bb;
         FOR_EACH_BB_FN(bb, fun) {
-                mpi_ranks *aux_ranks = (mpi_ranks *) bb -> aux;
-
-                int code = aux_ranks -> code;
-                int *ranks = aux_ranks -> ranks;
+                int *counts = counts_of_block(bb -> index);
+                int *ranks = ranks_of_block(bb -> index);
 
                 int index = bb -> index;
-		/* if the block contains a collective we set the index in the right bitmap depending on its rank */
-                if (code < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) {
-                        bitmap set = &sets[code][ranks[code]-1];
-                        bitmap_set_bit(set, index);
+		/* if the block contains collectives we set the index in the right bitmaps depending on their ranks */
+		/* a block executing n collectives of a kind has the n ranks ending at its own rank */
+                for (int c=0; c < nb_collective_classes; c++) {
+                        for (int n=0; n < counts[c]; n++) {
+                                bitmap set = &sets[c][ranks[c]-1-n];
+                                bitmap_set_bit(set, index);
+                        }
                 }
         }
 	#ifdef DEBUG
-	for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+	for (int i=0; i < nb_collective_classes; i++) {
                	int max_rank = ranks[i];
                	if (max_rank != 0) {
                        	for(int j=0; j < max_rank; j++) {
-                               	printf("code: %d, rank: %d - ", i, j+1);
+                               	printf("class: %d, rank: %d - ", i, j+1);
                                	bitmap_print(stdout, &sets[i][j], "", "");
                                	printf("\n");
                        	}
@@ -358,62 +1082,99 @@ bitmap_head** collective_rank_set(function *fun) {
         return sets;
 }
 /* calculate and return the postdominance of each set */
+/* all the sets are handled in one backward propagation from the exit: each block gets the sets */
+/* that one of its paths to the exit can avoid, the blocks postdominated by a set are the others */
 bitmap_head** set_post_dominance(function *fun, bitmap_head **sets) {
         basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
 
-        mpi_ranks *aux_ranks = (mpi_ranks *) last -> aux;
-
-        int *ranks = aux_ranks -> ranks;
+        int *ranks = ranks_of_block(last -> index);
 
         basic_block bb;
 
-        std::vector <basic_block> to_visit;
+        /* numbering of the sets, set_code and set_rank give the coordinates of each number */
+        std::vector <int> set_code;
+        std::vector <int> set_rank;
 
-        bitmap_head **post_dominated = XNEWVEC(bitmap_head*, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE);
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+        bitmap_head **post_dominated = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head*, nb_collective_classes);
+        for (int i=0; i < nb_collective_classes; i++) {
                 int max_rank = ranks[i];
                 if (max_rank != 0) {
-                        post_dominated[i] = XNEWVEC(bitmap_head, max_rank);
+                        post_dominated[i] = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, max_rank);
                         for(int j=0; j < max_rank; j++) {
-                                bitmap_initialize(&post_dominated[i][j], &bitmap_default_obstack);
-				
-				/* we start from the end of the graph and go up through the nodes that are not part of the set and not marked as not postdominated*/
-				/* the nodes we can go through are marked as not postdominated */
+                                bitmap_initialize(&post_dominated[i][j], &mpicoll_obstack);
+                                set_code.push_back(i);
+                                set_rank.push_back(j);
+                        }
+                }
+        }
+        int nb_sets = set_code.size();
+
+        /* in_sets is the bit-sliced membership of each block, avoided the sets it can avoid */
+        bitmap_head *in_sets = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, last_basic_block_for_fn(fun));
+        bitmap_head *avoided = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, last_basic_block_for_fn(fun));
+        for (int k=0; k < last_basic_block_for_fn(fun); k++) {
+                bitmap_initialize(&in_sets[k], &mpicoll_obstack);
+                bitmap_initialize(&avoided[k], &mpicoll_obstack);
+        }
+        for (int s=0; s < nb_sets; s++) {
+                unsigned k;
+                bitmap_iterator bi;
+                EXECUTE_IF_SET_IN_BITMAP(&sets[set_code[s]][set_rank[s]], 0, k, bi) {
+                        bitmap_set_bit(&in_sets[k], s);
+                }
+        }
 
-                                to_visit.push_back(last);
+        bitmap_head all_sets;
+        bitmap_initialize(&all_sets, &mpicoll_obstack);
+        bitmap_set_range(&all_sets, 0, nb_sets);
 
-                                while (to_visit.size() != 0) {
-                                        bb = to_visit.back();
-                                        to_visit.pop_back();
+	/* we start from the end of the graph and go up, a parent avoids the sets avoided by its child that it is not part of */
+        bitmap_head queued;
+        bitmap_initialize(&queued, &mpicoll_obstack);
+        std::vector <basic_block> to_visit;
 
-                                        bitmap_set_bit(&post_dominated[i][j], bb -> index);
+        bitmap_copy(&avoided[last -> index], &all_sets);
+        bitmap_set_bit(&queued, last -> index);
+        to_visit.push_back(last);
 
-                                        edge e;
-                                        edge_iterator it;
+        while (to_visit.size() != 0) {
+                bb = to_visit.back();
+                to_visit.pop_back();
+                bitmap_clear_bit(&queued, bb -> index);
 
-                                        FOR_EACH_EDGE(e, it, bb -> preds) {
-                                                basic_block parent = e -> src;
-                                                int parent_index = parent -> index;
-                                                if (!bitmap_bit_p(&sets[i][j], parent_index) && !bitmap_bit_p(&post_dominated[i][j], parent_index) && parent_index != 0) {
-                                                        to_visit.push_back(parent);
-                                                }
-                                        }
-                                }
-				/* reversing the bits in the bitmap to get the nodes that are postdominated */
-                                for (int k=1; k < last_basic_block_for_fn(fun); k++) {
-                                        if (bitmap_bit_p(&post_dominated[i][j], k)) bitmap_clear_bit(&post_dominated[i][j], k);
-                                        else bitmap_set_bit(&post_dominated[i][j], k);
-                                }
+                edge e;
+                edge_iterator it;
+
+                FOR_EACH_EDGE(e, it, bb -> preds) {
+                        basic_block parent = e -> src;
+                        int parent_index = parent -> index;
+                        if (parent_index == 0) continue;
+                        if (bitmap_ior_and_compl_into(&avoided[parent_index], &avoided[bb -> index], &in_sets[parent_index])
+                            && bitmap_set_bit(&queued, parent_index)) {
+                                to_visit.push_back(parent);
                         }
                 }
         }
+
+	/* the blocks that cannot avoid a set are postdominated by it */
+        for (int k=1; k < last_basic_block_for_fn(fun); k++) {
+                unsigned s;
+                bitmap_iterator bi;
+                EXECUTE_IF_AND_COMPL_IN_BITMAP(&all_sets, &avoided[k], 0, s, bi) {
+                        bitmap_set_bit(&post_dominated[set_code[s]][set_rank[s]], k);
+                }
+        }
+
+        bitmap_clear(&all_sets);
+        bitmap_clear(&queued);
+
 	#ifdef DEBUG
  	printf("---- set postdominated ----\n");
-       	for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+       	for (int i=0; i < nb_collective_classes; i++) {
                	int max_rank = ranks[i];
                	if (max_rank != 0) {
                        	for(int j=0; j < max_rank; j++) {
-                               	printf("code: %d, rank: %d - ", i, j+1);
+                               	printf("class: %d, rank: %d - ", i, j+1);
                                	bitmap_print(stdout, &post_dominated[i][j], "", "");
                                	printf("\n");
                        	}
@@ -428,36 +1189,31 @@ bitmap_head** set_post_dominance_frontiers(function * fun, bitmap_head **post_do
 {
         basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
 
-        mpi_ranks *aux_ranks = (mpi_ranks *) last -> aux;
+        int *ranks = ranks_of_block(last -> index);
 
-        int *ranks = aux_ranks -> ranks;
-
-        bitmap_head **set_frontiers = XNEWVEC(bitmap_head*, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE);
-        bitmap_head valid_frontiers;
-        bitmap_initialize(&valid_frontiers, &bitmap_default_obstack);
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+        bitmap_head **set_frontiers = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head*, nb_collective_classes);
+        for (int i=0; i < nb_collective_classes; i++) {
                 int max_rank = ranks[i];
                 if (max_rank != 0) {
-                        set_frontiers[i] = XNEWVEC(bitmap_head, max_rank);
+                        set_frontiers[i] = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, max_rank);
                         for(int j=0; j < max_rank; j++) {
-                                bitmap_initialize(&set_frontiers[i][j], &bitmap_default_obstack);
-                                for (int k=0; k < last_basic_block_for_fn(fun); k++) {
-					/* the frontier of the set is the union of the frontiers of blocks postdominated by set, frontiers that are not postdominated by the set */
-                                        if (bitmap_bit_p(&post_dominated[i][j], k)) {
-                                                bitmap_and_compl(&valid_frontiers, &frontiers[k], &post_dominated[i][j]);
-                                                bitmap_ior_into(&set_frontiers[i][j], &valid_frontiers);
-                                        }
+                                bitmap_initialize(&set_frontiers[i][j], &mpicoll_obstack);
+                                unsigned k;
+                                bitmap_iterator bi;
+				/* the frontier of the set is the union of the frontiers of blocks postdominated by set, frontiers that are not postdominated by the set */
+                                EXECUTE_IF_SET_IN_BITMAP(&post_dominated[i][j], 0, k, bi) {
+                                        bitmap_ior_and_compl_into(&set_frontiers[i][j], &frontiers[k], &post_dominated[i][j]);
                                 }
                         }
                 }
         }
 	#ifdef DEBUG
         printf("---- set frontiers ----\n");
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+        for (int i=0; i < nb_collective_classes; i++) {
                	int max_rank = ranks[i];
                	if (max_rank != 0) {
                        	for(int j=0; j < max_rank; j++) {
-                               	printf("code: %d, rank: %d - ", i, j+1);
+                               	printf("class: %d, rank: %d - ", i, j+1);
                                	bitmap_print(stdout, &set_frontiers[i][j], "", "");
                                	printf("\n");
                                	if (!bitmap_empty_p(&set_frontiers[i][j])) printf("Potential MPI Deadlock\n");
@@ -471,41 +1227,45 @@ bitmap_head** set_post_dominance_frontiers(function * fun, bitmap_head **post_do
 bitmap_head **iterated_post_dominance_frontiers(function *fun, bitmap_head **set_frontiers, bitmap_head *frontiers) {
         basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
 
-        mpi_ranks *aux_ranks = (mpi_ranks *) last -> aux;
+        int *ranks = ranks_of_block(last -> index);
 
-        int *ranks = aux_ranks -> ranks;
-
-        bitmap_head **set_iterated_frontiers = XNEWVEC(bitmap_head*, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE);
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+        bitmap_head **set_iterated_frontiers = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head*, nb_collective_classes);
+        for (int i=0; i < nb_collective_classes; i++) {
                 int max_rank = ranks[i];
                 if (max_rank != 0) {
-                        set_iterated_frontiers[i] = XNEWVEC(bitmap_head, max_rank);
+                        set_iterated_frontiers[i] = XOBNEWVEC(&mpicoll_obstack.obstack, bitmap_head, max_rank);
                         for(int j=0; j < max_rank; j++) {
-                                bitmap_initialize(&set_iterated_frontiers[i][j], &bitmap_default_obstack);
+                                bitmap_initialize(&set_iterated_frontiers[i][j], &mpicoll_obstack);
                                 bitmap_ior_into(&set_iterated_frontiers[i][j], &set_frontiers[i][j]);
 				
-				/* we add the frontiers of the blocks in the frontier and we keep adding the frontiers of those frontiers until no new blocks are added */
-                                unsigned long old_count = bitmap_count_bits(&set_iterated_frontiers[i][j]);
-                                unsigned long new_count = 0;
-                                while (old_count != new_count) {
-                                        old_count = bitmap_count_bits(&set_iterated_frontiers[i][j]);
-                                        for (int k=0; k < last_basic_block_for_fn(fun); k++) {
-                                                if (bitmap_bit_p(&set_iterated_frontiers[i][j], k)) {
-                                                        bitmap_ior_into(&set_iterated_frontiers[i][j], &frontiers[k]);
-                                                }
+				/* we add the frontiers of the blocks in the frontier, each block newly added is queued */
+				/* so that its own frontier is added exactly once */
+                                std::vector <unsigned> to_visit;
+                                unsigned k;
+                                bitmap_iterator bi;
+                                EXECUTE_IF_SET_IN_BITMAP(&set_frontiers[i][j], 0, k, bi) {
+                                        to_visit.push_back(k);
+                                }
+                                while (to_visit.size() != 0) {
+                                        unsigned block = to_visit.back();
+                                        to_visit.pop_back();
+
+                                        unsigned f;
+                                        bitmap_iterator fi;
+                                        EXECUTE_IF_SET_IN_BITMAP(&frontiers[block], 0, f, fi) {
+                                                if (bitmap_set_bit(&set_iterated_frontiers[i][j], f)) to_visit.push_back(f);
                                         }
-                                        new_count = bitmap_count_bits(&set_iterated_frontiers[i][j]);
                                 }
                         }
                 }
         }
 	#ifdef DEBUG
         printf("---- set iterated frontiers ----\n");
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+        for (int i=0; i < nb_collective_classes; i++) {
                	int max_rank = ranks[i];
                	if (max_rank != 0) {
                        	for(int j=0; j < max_rank; j++) {
-                               	printf("code: %d, rank: %d - ", i, j+1);
+                               	printf("class: %d, rank: %d - ", i, j+1);
                                	bitmap_print(stdout, &set_iterated_frontiers[i][j], "", "");
                                	printf("\n");
                                	if (!bitmap_empty_p(&set_iterated_frontiers[i][j])) printf("Potential MPI Deadlock\n");
@@ -517,230 +1277,1412 @@ bitmap_head **iterated_post_dominance_frontiers(function *fun, bitmap_head **set
 }
 
 
-bool print_warnings(function *fun, bitmap_head **iterated_pdf, bitmap_head ** set) {
-        basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
-        mpi_ranks *aux_ranks = (mpi_ranks *) last -> aux;
-	bool warnings = false;
-        int *ranks = aux_ranks -> ranks;
-        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
-                int max_rank = ranks[i];
-                if (max_rank != 0) {
-                        for(int j=0; j < max_rank; j++) {
-                                if (!bitmap_empty_p(&iterated_pdf[i][j])) {
-					warnings = true;
-                                        for (int k=0; k < last_basic_block_for_fn(fun); k++) {
-                                                if (bitmap_bit_p(&set[i][j], k)) {
-                                                        basic_block bb = BASIC_BLOCK_FOR_FN(fun, k);
-                                                        gimple_stmt_iterator gsi;
-                                                        gimple *stmt;
-                                                        for (gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
-                                                                stmt = gsi_stmt(gsi);
-                                                                if (is_gimple_call(stmt)) {
-                                                                        tree function_decl = gimple_call_fndecl(stmt);
-                                                                        const char* func_name = get_name(function_decl);
-                                                                        if (strcmp(func_name, mpi_collective_name[i]) == 0) {
-                                                                                warning_at(gimple_location(stmt), 0, "Potential issue: MPI collective %s in block %d", mpi_collective_name[i], k);
-                                                                        }
-                                                                }
-                                                        }
-                                                }
-                                        }
-                                        for (int k=0; k < last_basic_block_for_fn(fun); k++) {
-                                                if (bitmap_bit_p(&iterated_pdf[i][j], k)) {
-                                                        basic_block bb = BASIC_BLOCK_FOR_FN(fun, k);
-                                                        gimple_stmt_iterator gsi = gsi_last_bb(bb);
-                                                        gimple *stmt = gsi_stmt(gsi);
-                                                        if (!gsi_end_p(gsi)) {
-                                                                stmt = gsi_stmt(gsi);
-                                                        }
-                                                        warning_at(gimple_location(stmt), 0, "Potential issue caused by the following fork in block %d", k);
-                                                }
-                                        }
+/* Rank-dependent forks */
+
+/* Given by -fplugin-arg-libplugin-all-forks, every fork of the frontiers is reported as before */
+static bool all_forks;
+
+/* Forks of the current function that may go different ways on different processes, the other forks */
+/* are removed from the iterated frontiers before the warnings, NULL when all the forks are kept */
+static bitmap rank_dependent_forks;
+
+/* Variables and SSA names of the current function whose value may differ between processes */
+static hash_set<tree> *tainted_values;
+
+/* returns the first operand that may differ between processes: the parameters, the global and */
+/* addressable variables, the memory read through a pointer and the tainted values */
+static tree taint_visit_operand(tree *tp, int *walk_subtrees, void *data)
+{
+        tree t = *tp;
+        switch (TREE_CODE(t)) {
+        case ADDR_EXPR:
+                /* the object is not read */
+                *walk_subtrees = 0;
+                return NULL_TREE;
+        case MEM_REF:
+        case TARGET_MEM_REF:
+                return t;
+        case SSA_NAME:
+                return SSA_NAME_IS_DEFAULT_DEF(t) || tainted_values -> contains(t) ? t : NULL_TREE;
+        case PARM_DECL:
+        case RESULT_DECL:
+                return t;
+        case VAR_DECL:
+                return is_global_var(t) || TREE_ADDRESSABLE(t) || tainted_values -> contains(t) ? t : NULL_TREE;
+        default:
+                return NULL_TREE;
+        }
+}
+
+static bool tainted_operand(tree op)
+{
+        if (op == NULL_TREE) return false;
+        return walk_tree(&op, taint_visit_operand, NULL, NULL) != NULL_TREE;
+}
+
+/* taints the variable written by a statement, returns true if it was not tainted yet */
+/* a store through a pointer needs nothing: the memory read through a pointer is always tainted */
+static bool taint_lhs(tree lhs)
+{
+        if (lhs == NULL_TREE) return false;
+        if (TREE_CODE(lhs) != SSA_NAME) lhs = get_base_address(lhs);
+        if (lhs == NULL_TREE || (TREE_CODE(lhs) != SSA_NAME && TREE_CODE(lhs) != VAR_DECL)) return false;
+        return !tainted_values -> add(lhs);
+}
+
+/* returns true if the fork ending the block may go different ways on different processes */
+static bool fork_is_tainted(basic_block bb)
+{
+        gimple *stmt = last_stmt(bb);
+        if (stmt == NULL) return true;
+        if (gimple_code(stmt) == GIMPLE_COND) return tainted_operand(gimple_cond_lhs(stmt)) || tainted_operand(gimple_cond_rhs(stmt));
+        if (gimple_code(stmt) == GIMPLE_SWITCH) return tainted_operand(gimple_switch_index(as_a <gswitch *> (stmt)));
+        return true;
+}
+
+/* returns the forks of the function that may depend on the process, the taint comes from the values */
+/* read from outside of the function: MPI_Comm_rank, MPI_Comm_size, getenv, the I/O and any other call */
+/* return a value that may differ, only the const functions of untainted arguments do not */
+/* a block executed under a tainted fork (one of its post-dominance frontiers, iterated) is divergent: */
+/* the variables it writes are tainted, so are the PHI nodes joining the paths of a tainted fork */
+bitmap find_rank_dependent_forks(function *fun, bitmap_head *frontiers)
+{
+        basic_block bb;
+        bitmap forks = BITMAP_ALLOC(&mpicoll_obstack);
+        bitmap divergent = BITMAP_ALLOC(&mpicoll_obstack);
+
+        if (tainted_values == NULL) tainted_values = new hash_set<tree>;
+        tainted_values -> empty();
+
+        bool changed = true;
+        while (changed) {
+                changed = false;
+
+                FOR_EACH_BB_FN(bb, fun) {
+                        if (EDGE_COUNT(bb -> succs) >= 2 && !bitmap_bit_p(forks, bb -> index) && fork_is_tainted(bb)) {
+                                bitmap_set_bit(forks, bb -> index);
+                                changed = true;
+                        }
+                }
+                bool grown = true;
+                while (grown) {
+                        grown = false;
+                        FOR_EACH_BB_FN(bb, fun) {
+                                if (bitmap_bit_p(divergent, bb -> index)) continue;
+                                if (bitmap_intersect_p(&frontiers[bb -> index], forks) || bitmap_intersect_p(&frontiers[bb -> index], divergent)) {
+                                        bitmap_set_bit(divergent, bb -> index);
+                                        grown = changed = true;
                                 }
                         }
                 }
-        }
-	return warnings;
-}
 
-/* Pragma Handling  */
+                FOR_EACH_BB_FN(bb, fun) {
+                        bool in_divergent = bitmap_bit_p(divergent, bb -> index);
 
-static std::vector<tree> fname_vec;
+                        /* SSA form: the value of a PHI node depends on the path taken to its block */
+                        bool tainted_join = in_divergent;
+                        edge e;
+                        edge_iterator ei;
+                        FOR_EACH_EDGE(e, ei, bb -> preds) {
+                                if (bitmap_bit_p(divergent, e -> src -> index) || bitmap_bit_p(forks, e -> src -> index)) tainted_join = true;
+                        }
+                        for (gphi_iterator gpi = gsi_start_phis(bb); !gsi_end_p(gpi); gsi_next(&gpi)) {
+                                gphi *phi = gpi.phi();
+                                bool tainted = tainted_join;
+                                for (unsigned i = 0; i < gimple_phi_num_args(phi) && !tainted; i++) tainted = tainted_operand(gimple_phi_arg_def(phi, i));
+                                if (tainted && taint_lhs(gimple_phi_result(phi))) changed = true;
+                        }
 
-bool is_function_in_pragma_list(const char* fname) {
-        for (auto elem : fname_vec) {
-                if (strcmp(fname, IDENTIFIER_POINTER(elem)) == 0) {
-                return true;
+                        for (gimple_stmt_iterator gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
+                                gimple *stmt = gsi_stmt(gsi);
+                                bool tainted = in_divergent;
+                                if (is_gimple_assign(stmt)) {
+                                        for (unsigned i = 1; i < gimple_num_ops(stmt) && !tainted; i++) tainted = tainted_operand(gimple_op(stmt, i));
+                                        if (tainted && taint_lhs(gimple_assign_lhs(stmt))) changed = true;
+                                }
+                                else if (is_gimple_call(stmt) && gimple_call_lhs(stmt) != NULL_TREE) {
+                                        tainted = tainted || !(gimple_call_flags(stmt) & ECF_CONST);
+                                        for (unsigned i = 0; i < gimple_call_num_args(stmt) && !tainted; i++) tainted = tainted_operand(gimple_call_arg(stmt, i));
+                                        if (tainted && taint_lhs(gimple_call_lhs(stmt))) changed = true;
+                                }
+                                else if (gimple_code(stmt) == GIMPLE_ASM) {
+                                        gasm *asm_stmt = as_a <gasm *> (stmt);
+                                        for (unsigned i = 0; i < gimple_asm_noutputs(asm_stmt); i++) {
+                                                if (taint_lhs(TREE_VALUE(gimple_asm_output_op(asm_stmt, i)))) changed = true;
+                                        }
+                                }
+                        }
                 }
         }
-        return false;
+
+        #ifdef DEBUG
+        printf("----------------- rank dependent forks ------------------------\n");
+        bitmap_print(stdout, forks, "", "\n");
+        #endif
+        return forks;
 }
 
-bool remove_function_from_pragma_list(const char* fname) {
-        for (auto it = fname_vec.begin(); it != fname_vec.end(); ++it) {
-                if (strcmp(fname, IDENTIFIER_POINTER(*it)) == 0) {
-                fname_vec.erase(it); // Remove the found element
-                return true; // Indicate that the element was found and removed
-                }
-        }
-        return false; // Indicate that the element was not found
+/* computes the post-dominance frontiers of the blocks and the forks that may depend on the process */
+static bitmap_head *rank_dependent_frontiers(function *fun)
+{
+        phase_start(PHASE_PDF);
+        calculate_dominance_info(CDI_POST_DOMINATORS);
+        bitmap_head *frontiers = post_dominance_frontiers(fun);
+        phase_stop(PHASE_PDF);
+
+        phase_start(PHASE_TAINT);
+        rank_dependent_forks = find_rank_dependent_forks(fun, frontiers);
+        phase_stop(PHASE_TAINT);
+        return frontiers;
 }
 
-static void handle_arg(tree pragma_arg) {
-        const char *func_name = IDENTIFIER_POINTER(pragma_arg);
-        if (is_function_in_pragma_list(func_name)) {
-                warning(0, "%<#pragma ProjetCA mpicoll_check%> function '%s' appears multiple times", func_name);
-        } else {
-                fname_vec.push_back(pragma_arg);
+/* removes the forks that go the same way on every process from the iterated frontiers of the sets */
+void prune_uniform_forks(function *fun, bitmap_head **iterated_pdf)
+{
+        int *ranks = ranks_of_block(EXIT_BLOCK_PTR_FOR_FN(fun) -> index);
+        for (int i=0; i < nb_collective_classes; i++) {
+                for (int j=0; j < ranks[i]; j++) bitmap_and_into(&iterated_pdf[i][j], rank_dependent_forks);
         }
 }
 
-static void
-handle_pragma_fx(cpp_reader *dummy ATTRIBUTE_UNUSED)
+/* Loop summaries */
+
+/* Headers of the loops whose collectives are summarized, NULL when none is: every iteration executes */
+/* the same collectives on every path and the forks leaving the loop do not depend on the process, */
+/* so every process entering the loop executes them the same number of times. The counts of the */
+/* loop are moved to its header, so a loop is reported as a unit. Only the counts move: the */
+/* analysis still runs on every block of the function, the loops are not analyzed as regions */
+static bitmap summarized_loops;
+static int nb_summarized_loops;
+
+/* Blocks executing the collectives of each summarized loop, inner loops included, in dominance order */
+/* they are found once by summarize_loops, summarized_nodes_index gives them for the header */
+static std::vector <std::vector <basic_block> > summarized_nodes;
+static hash_map<int_hash<int, -1, -2>, int> *summarized_nodes_index;
+
+/* returns the blocks whose statements execute the collectives counted in block k: the blocks of the */
+/* loop with collectives for the header of a summarized loop, the block itself otherwise */
+static std::vector <basic_block> blocks_of_counts(function *fun, int k)
 {
-        enum cpp_ttype token;
-        bool close_paren_needed = false;
-        tree pragma_arg;
-                
-        if (cfun) {
-                error("%<#pragma ProjetCA mpicoll_check%> pragma not allowed inside a function definition");
-                return;
+        if (summarized_loops != NULL && bitmap_bit_p(summarized_loops, k)) {
+                int *n = summarized_nodes_index -> get(k);
+                if (n != NULL) return summarized_nodes[*n];
         }
+        return std::vector <basic_block> (1, BASIC_BLOCK_FOR_FN(fun, k));
+}
 
-        token = pragma_lex(&pragma_arg);
-        if (CPP_OPEN_PAREN == token) {
-                close_paren_needed = true;
-                token = pragma_lex(&pragma_arg);
-                if (CPP_NAME != token) {
-                error("%<#pragma ProjetCA mpicoll_check%> argument is not a name");
-                return;
+/* summarizes the loops of the function from the innermost, once each, returns the number of summarized loops */
+/* the nodes of a loop are its blocks executing collectives and the headers of its summarized inner loops */
+/* a loop is summarized when every node dominates the latches, when each exit leaves from a fork that does not */
+/* depend on the process and comes before or after all the nodes (not a break between two collectives), and */
+/* when no other block of the loop executes a collective (an inner loop that is not summarized) */
+int summarize_loops(function *fun)
+{
+        if (loops_for_fn(fun) == NULL || loops_state_satisfies_p(fun, LOOPS_NEED_FIXUP)) return 0;
+
+        bool computed = !dom_info_available_p(CDI_DOMINATORS);
+        if (computed) calculate_dominance_info(CDI_DOMINATORS);
+
+        summarized_loops = BITMAP_ALLOC(&mpicoll_obstack);
+        if (summarized_nodes_index == NULL) summarized_nodes_index = new hash_map<int_hash<int, -1, -2>, int>;
+        int nb_summarized = 0;
+
+        for (auto loop : loops_list(fun, LI_FROM_INNERMOST)) {
+                basic_block *body = get_loop_body_in_dom_order(loop);
+                std::vector <basic_block> nodes;
+                bool uniform = true;
+                for (unsigned n = 0; n < loop -> num_nodes && uniform; n++) {
+                        basic_block bb = body[n];
+                        if (!block_has_collective(bb -> index)) continue;
+                        if (bb -> loop_father == loop
+                            || (bitmap_bit_p(summarized_loops, bb -> index) && loop_outer(bb -> loop_father) == loop)) nodes.push_back(bb);
+                        else uniform = false;
                 }
-                
-                handle_arg(pragma_arg);
-                
-                token = pragma_lex(&pragma_arg);
-                if (token == CPP_NAME) {
-                        error("%<#pragma ProjetCA mpicoll_check%> list must be separated by commas");
-                        return;
+                free(body);
+                if (nodes.empty() || !uniform) continue;
+
+                /* every iteration executes every node */
+                auto_vec<edge> latches = get_loop_latch_edges(loop);
+                for (unsigned l = 0; l < latches.length() && uniform; l++) {
+                        for (size_t n = 0; n < nodes.size() && uniform; n++) {
+                                if (!dominated_by_p(CDI_DOMINATORS, latches[l] -> src, nodes[n])) uniform = false;
+                        }
                 }
-                while (CPP_COMMA == token) {
-                token = pragma_lex(&pragma_arg);
-                if (CPP_NAME != token) {
-                        error("%<#pragma ProjetCA mpicoll_check%> argument is not a name");
-                        return;
+
+                /* every process leaves the loop at the same iteration, before or after all the nodes */
+                auto_vec<edge> exits = get_loop_exit_edges(loop);
+                for (unsigned x = 0; x < exits.length() && uniform; x++) {
+                        basic_block src = exits[x] -> src;
+                        if ((exits[x] -> flags & (EDGE_ABNORMAL | EDGE_EH)) || EDGE_COUNT(src -> succs) < 2
+                            || bitmap_bit_p(rank_dependent_forks, src -> index)) {
+                                uniform = false;
+                                break;
+                        }
+                        bool before = true, after = true;
+                        for (size_t n = 0; n < nodes.size(); n++) {
+                                if (!dominated_by_p(CDI_DOMINATORS, nodes[n], src)) before = false;
+                                if (!dominated_by_p(CDI_DOMINATORS, src, nodes[n])) after = false;
+                        }
+                        if (!before && !after) uniform = false;
                 }
-                handle_arg(pragma_arg);
-                token = pragma_lex(&pragma_arg);
+                if (!uniform) continue;
+
+                int *header_counts = counts_of_block(loop -> header -> index);
+                for (size_t n = 0; n < nodes.size(); n++) {
+                        if (nodes[n] == loop -> header) continue;
+                        int *counts = counts_of_block(nodes[n] -> index);
+                        for (int i=0; i < nb_collective_classes; i++) {
+                                header_counts[i] += counts[i];
+                                counts[i] = 0;
+                        }
                 }
-        } else if (CPP_NAME == token) {
-                handle_arg(pragma_arg);
-                token = pragma_lex(&pragma_arg);
-        }else {
-                error("%<#pragma ProjetCA mpicoll_check%> argument is not a name");
-                return;
-        }
-
-        if (CPP_CLOSE_PAREN == token) {
-                if (!close_paren_needed) {
-                error("%<#pragma ProjetCA mpicoll_check%> unexpected closing perenthesis");
-                return;
+                bitmap_set_bit(summarized_loops, loop -> header -> index);
+                nb_summarized++;
+
+                /* the blocks of a summarized inner loop replace its header */
+                std::vector <basic_block> blocks;
+                for (size_t n = 0; n < nodes.size(); n++) {
+                        int *inner = nodes[n] -> loop_father != loop ? summarized_nodes_index -> get(nodes[n] -> index) : NULL;
+                        if (inner != NULL) blocks.insert(blocks.end(), summarized_nodes[*inner].begin(), summarized_nodes[*inner].end());
+                        else blocks.push_back(nodes[n]);
                 }
-                close_paren_needed = false;
-                token = pragma_lex(&pragma_arg);
+                summarized_nodes_index -> put(loop -> header -> index, summarized_nodes.size());
+                summarized_nodes.push_back(blocks);
+
+                #ifdef DEBUG
+                printf("[LOOP] loop %d, header %d, depth %d: [", loop -> num, loop -> header -> index, loop_depth(loop));
+                for (int i=0; i < nb_collective_classes; i++) printf("%d, ", header_counts[i]);
+                printf("]\n");
+                #endif
         }
 
-        if (CPP_EOF == token) {
-                if (close_paren_needed) {
-                error("%<#pragma ProjetCA mpicoll_check%> missing closing perenthesis");
+        if (computed) free_dominance_info(CDI_DOMINATORS);
+        return nb_summarized;
+}
+
+/* Kinds of warnings, a warning is identified by its kind, the class of its collectives and its block */
+enum mpicoll_warning_kind {
+        WARNING_COLLECTIVE,
+        WARNING_FORK
+} ;
+
+struct mpicoll_warning {
+        unsigned int kind;
+        unsigned int code;      /* class of the collectives */
+        unsigned int block;
+};
+
+/* Warnings printed for the current function, kept to be stored in the cache */
+static std::vector <mpicoll_warning> printed_warnings;
+
+/* Collectives of the current function checked at run time, by class and block, kept to be stored in the cache */
+struct mpicoll_check {
+        unsigned int code;      /* class of the collectives */
+        unsigned int block;
+};
+static std::vector <mpicoll_check> instrumented_checks;
+
+/* prints the warnings of the collectives of class i in block k */
+static void warn_collectives_in_block(function *fun, int k, int i) {
+        basic_block bb = BASIC_BLOCK_FOR_FN(fun, k);
+        gimple_stmt_iterator gsi;
+        gimple *stmt;
+        int code = collective_classes[i].code;
+        /* the collectives of a summarized loop are in the blocks of its body */
+        /* the warning is kept for the block of the statements, the cache replays it without the loops */
+        std::vector <basic_block> blocks = blocks_of_counts(fun, k);
+        for (size_t b = 0; b < blocks.size(); b++) {
+                bb = blocks[b];
+                bool printed = blocks.size() == 1;
+                for (gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
+                        stmt = gsi_stmt(gsi);
+                        collective_summary *summary = summary_of_call(stmt);
+                        if (is_mpi_call(stmt) == code && class_of_collective(stmt, code) == i) {
+                                warning_at(gimple_location(stmt), 0, "Potential issue: MPI collective %s in block %d", mpi_collective_name[code], bb -> index);
+                                printed = true;
+                        }
+                        else if (summary != NULL && summary -> counts[code] != 0) {
+                                warning_at(gimple_location(stmt), 0, "Potential issue: MPI collective %s in block %d, called through %qD",
+                                                mpi_collective_name[code], bb -> index, gimple_call_fndecl(stmt));
+                                printed = true;
+                        }
+                }
+                if (printed) {
+                        mpicoll_warning w = { WARNING_COLLECTIVE, (unsigned int) i, (unsigned int) bb -> index };
+                        printed_warnings.push_back(w);
                 }
         }
-        else {
-                error("%<#pragma ProjetCA mpicoll_check%> expected parenthesis for list");
-                return;
-        }
+}
 
+/* prints the warning of the fork ending block k */
+static void warn_fork(function *fun, int k) {
+        basic_block bb = BASIC_BLOCK_FOR_FN(fun, k);
+        gimple_stmt_iterator gsi = gsi_last_bb(bb);
+        gimple *stmt = gsi_stmt(gsi);
+        if (!gsi_end_p(gsi)) {
+                stmt = gsi_stmt(gsi);
+        }
+        warning_at(gimple_location(stmt), 0, "Potential issue caused by the following fork in block %d", k);
+        mpicoll_warning w = { WARNING_FORK, 0, (unsigned int) k };
+        printed_warnings.push_back(w);
 }
 
-void not_declared_functions(void *event_data, void *data) {
-	for (auto elem : fname_vec) {
-		const char* func_name = IDENTIFIER_POINTER(elem);
-		location_t loc = UNKNOWN_LOCATION;
-		warning_at(loc, 0, "%<#pragma ProjetCA mpicoll_check%> function '%s' is not declared but referenced in pragma", func_name);
-   	}	
+bool print_warnings(function *fun, bitmap_head **iterated_pdf, bitmap_head ** set) {
+        basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
+	bool warnings = false;
+        int *ranks = ranks_of_block(last -> index);
+        for (int i=0; i < nb_collective_classes; i++) {
+                int max_rank = ranks[i];
+                if (max_rank != 0) {
+                        for(int j=0; j < max_rank; j++) {
+                                if (!bitmap_empty_p(&iterated_pdf[i][j])) {
+					warnings = true;
+                                        for (int k=0; k < last_basic_block_for_fn(fun); k++) {
+                                                /* a block calling a summarized function can be in several sets of the collective */
+                                                if (j > 0 && bitmap_bit_p(&set[i][j-1], k) && !bitmap_empty_p(&iterated_pdf[i][j-1])) continue;
+                                                if (bitmap_bit_p(&set[i][j], k)) warn_collectives_in_block(fun, k, i);
+                                        }
+                                        for (int k=0; k < last_basic_block_for_fn(fun); k++) {
+                                                if (bitmap_bit_p(&iterated_pdf[i][j], k)) warn_fork(fun, k);
+                                        }
+                                }
+                        }
+                }
+        }
+	return warnings;
 }
 
-/* Graphviz */
+/* Overlap suggestions */
+
+/* Minimum number of statements independent of a blocking collective for a suggestion, */
+/* given by -fplugin-arg-libplugin-overlap[=<statements>], 0 when the suggestions are disabled */
+static int overlap_min_statements;
 
-/* Build a filename (as a string) based on function name */
-static char * cfgviz_generate_filename( function * fun, const char * suffix )
+#define OVERLAP_DEFAULT_MIN_STATEMENTS 4
+
+/* Buffers of a collective, NULL_TREE when there is none, and whether a statement conflicts with them */
+struct overlap_buffers {
+        tree send;
+        tree recv;
+        bool conflict;
+};
+
+/* returns false if a buffer argument is not the address of a variable or a constant, its accesses are then unknown */
+static bool overlap_buffer_variable(gimple *stmt, int index, tree *var)
 {
-	char * target_filename ;
+        *var = NULL_TREE;
+        if (index < 0 || (unsigned) index >= gimple_call_num_args(stmt)) return true;
 
-	target_filename = (char *)xmalloc( 1024 * sizeof( char ) ) ;
+        tree arg = gimple_call_arg(stmt, index);
+        if (TREE_CODE(arg) == INTEGER_CST) return true;         /* MPI_IN_PLACE, MPI_BOTTOM */
+        if (TREE_CODE(arg) != ADDR_EXPR) return false;
 
-	snprintf( target_filename, 1024, "graph/%s_%s_%d_%s.dot",
-			current_function_name(),
-			LOCATION_FILE( fun->function_start_locus )+6,
-			LOCATION_LINE( fun->function_start_locus ),
-			suffix ) ;
+        tree base = get_base_address(TREE_OPERAND(arg, 0));
+        if (base == NULL_TREE || !DECL_P(base)) return false;
+        *var = base;
+        return true;
+}
 
-	return target_filename ;
+/* the send buffer can be read until the wait, the receive buffer cannot be accessed at all */
+/* an access through a pointer may be an access to a buffer, their address is taken */
+static bool overlap_visit_load(gimple *stmt, tree base, tree op, void *data)
+{
+        overlap_buffers *buffers = (overlap_buffers *) data;
+        if (buffers -> recv != NULL_TREE && (base == buffers -> recv || !DECL_P(base))) buffers -> conflict = true;
+        return false;
 }
 
-/* Dump the graphviz representation of function 'fun' in file 'out' */
-static void cfgviz_internal_dump( function * fun, FILE * out, bitmap valid_edges)
+static bool overlap_visit_store(gimple *stmt, tree base, tree op, void *data)
 {
-	basic_block bb;
-	// Print the header line and open the main graph
-	fprintf(out, "Digraph G{\n");
+        overlap_buffers *buffers = (overlap_buffers *) data;
+        if ((buffers -> send != NULL_TREE || buffers -> recv != NULL_TREE)
+            && (base == buffers -> send || base == buffers -> recv || !DECL_P(base))) buffers -> conflict = true;
+        return false;
+}
 
-	FOR_ALL_BB_FN(bb, fun)
+/* returns the statement following *gsi in the blocks executed right after it, */
+/* NULL at a branch or a join: the region goes on in a successor that has no other predecessor */
+static gimple *next_region_statement(function *fun, basic_block *region, gimple_stmt_iterator *gsi)
+{
+        gsi_next(gsi);
+        while (true) {
+                if (gsi_end_p(*gsi)) {
+                        if (!single_succ_p(*region)) return NULL;
+                        basic_block succ = single_succ(*region);
+                        if (succ == EXIT_BLOCK_PTR_FOR_FN(fun) || !single_pred_p(succ)) return NULL;
+                        *region = succ;
+                        *gsi = gsi_start_bb(succ);
+                        continue;
+                }
+                gimple *stmt = gsi_stmt(*gsi);
+                if (!is_gimple_debug(stmt) && gimple_code(stmt) != GIMPLE_LABEL && gimple_code(stmt) != GIMPLE_NOP) return stmt;
+                gsi_next(gsi);
+        }
+}
+
+/* returns false for the statements whose memory accesses cannot be listed: calls, asm and volatile accesses */
+static bool region_statement_is_plain(gimple *stmt)
+{
+        return !(is_gimple_call(stmt) && !(gimple_call_flags(stmt) & ECF_CONST))
+                && gimple_code(stmt) != GIMPLE_ASM && !gimple_has_volatile_ops(stmt);
+}
+
+/* suggests the non-blocking form of the blocking collectives followed by enough statements not using */
+/* their buffers, the statements are looked for in the blocks following the collective without a join */
+void suggest_overlaps(function *fun)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        int code = is_mpi_call(stmt);
+                        if (code == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE || !(mpi_collective_flags[code] & MPICOLL_BLOCKING)
+                            || mpi_collective_nonblocking[code] == MPICOLL_NO_CODE) continue;
+
+                        overlap_buffers buffers;
+                        buffers.conflict = false;
+                        if (!overlap_buffer_variable(stmt, mpi_collective_arg[code].send, &buffers.send)
+                            || !overlap_buffer_variable(stmt, mpi_collective_arg[code].recv, &buffers.recv)) continue;
+
+                        int independent = 0;
+                        gimple *wait_before = NULL;
+                        basic_block region = bb;
+                        gimple_stmt_iterator next = gsi;
+                        gimple *s;
+                        while ((s = next_region_statement(fun, &region, &next)) != NULL) {
+                                /* a call may use the buffers through their address */
+                                if (!region_statement_is_plain(s)) {
+                                        wait_before = s;
+                                        break;
+                                }
+                                walk_stmt_load_store_ops(s, &buffers, overlap_visit_load, overlap_visit_store);
+                                if (buffers.conflict) {
+                                        wait_before = s;
+                                        break;
+                                }
+                                if (is_gimple_assign(s)) independent++;
+                        }
+
+                        if (independent < overlap_min_statements) continue;
+                        inform(gimple_location(stmt), "%s is followed by %d statements that do not use its buffers, "
+                                        "%s with a later wait could overlap them", mpi_collective_name[code], independent,
+                                        mpi_collective_name[mpi_collective_nonblocking[code]]);
+                        if (wait_before != NULL && gimple_location(wait_before) != UNKNOWN_LOCATION) {
+                                inform(gimple_location(wait_before), "the wait would be needed before this statement");
+                        }
+                }
+        }
+}
+
+/* Fusion of reductions */
+
+/* Reports the reductions that could be merged into one, given by -fplugin-arg-libplugin-fusion */
+static bool fusion_enabled;
+
+/* returns true if a reduction can be merged with the other reductions of its kind: */
+/* its buffers are named variables and it is not in place */
+static bool fusable_reduction(gimple *stmt, int code, overlap_buffers *buffers)
+{
+        if (code == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE || !(mpi_collective_flags[code] & MPICOLL_REDUCTION)
+            || !(mpi_collective_flags[code] & MPICOLL_BLOCKING) || mpi_collective_arg[code].count < 0) return false;
+
+        buffers -> conflict = false;
+        return overlap_buffer_variable(stmt, mpi_collective_arg[code].send, &buffers -> send)
+                && overlap_buffer_variable(stmt, mpi_collective_arg[code].recv, &buffers -> recv)
+                && buffers -> send != NULL_TREE && buffers -> recv != NULL_TREE;
+}
+
+/* returns true if two reductions of the same kind have the same arguments apart from their buffers and count: */
+/* communicator, datatype, operation and root */
+static bool same_reduction(gimple *first, gimple *stmt, int code)
+{
+        if (gimple_call_num_args(first) != gimple_call_num_args(stmt)) return false;
+
+        const mpi_collective_args &arg = mpi_collective_arg[code];
+        for (unsigned i = 0; i < gimple_call_num_args(stmt); i++) {
+                if ((int) i == arg.send || (int) i == arg.recv || (int) i == arg.count) continue;
+                if (!operand_equal_p(gimple_call_arg(first, i), gimple_call_arg(stmt, i), 0)) return false;
+        }
+        return true;
+}
+
+/* reports the sequences of reductions with the same communicator, datatype and operation */
+/* where no statement between them uses the result of a previous one or changes the data of a previous one */
+void find_fusable_reductions(function *fun)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+        hash_set<gimple *> fused;
+
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *first = gsi_stmt(gsi);
+                        int code = is_mpi_call(first);
+                        overlap_buffers first_buffers;
+                        if (fused.contains(first) || !fusable_reduction(first, code, &first_buffers)) continue;
+
+                        std::vector<gimple *> group;
+                        std::vector<overlap_buffers> group_buffers;
+                        group.push_back(first);
+                        group_buffers.push_back(first_buffers);
+
+                        basic_block region = bb;
+                        gimple_stmt_iterator next = gsi;
+                        gimple *s;
+                        while ((s = next_region_statement(fun, &region, &next)) != NULL) {
+                                overlap_buffers buffers;
+                                int next_code = is_mpi_call(s);
+                                if (next_code == code && fusable_reduction(s, next_code, &buffers) && same_reduction(first, s, code)) {
+                                        /* the data of the reduction must not be the result of a previous one */
+                                        for (unsigned k = 0; k < group_buffers.size(); k++) {
+                                                if (buffers.send == group_buffers[k].recv) buffers.conflict = true;
+                                        }
+                                        if (buffers.conflict) break;
+                                        group.push_back(s);
+                                        group_buffers.push_back(buffers);
+                                        continue;
+                                }
+                                if (!region_statement_is_plain(s)) break;
+
+                                bool conflict = false;
+                                for (unsigned k = 0; k < group_buffers.size(); k++) {
+                                        walk_stmt_load_store_ops(s, &group_buffers[k], overlap_visit_load, overlap_visit_store);
+                                        conflict |= group_buffers[k].conflict;
+                                }
+                                if (conflict) break;
+                        }
+
+                        if (group.size() < 2) continue;
+
+                        /* combined count, the constant counts are added */
+                        std::string count;
+                        unsigned HOST_WIDE_INT constant = 0;
+                        for (unsigned k = 0; k < group.size(); k++) {
+                                tree arg = gimple_call_arg(group[k], mpi_collective_arg[code].count);
+                                fused.add(group[k]);
+                                if (tree_fits_uhwi_p(arg)) {
+                                        constant += tree_to_uhwi(arg);
+                                        continue;
+                                }
+                                char *expr = print_generic_expr_to_str(arg);
+                                if (!count.empty()) count += " + ";
+                                count += expr;
+                                free(expr);
+                        }
+                        if (constant != 0 || count.empty()) {
+                                if (!count.empty()) count += " + ";
+                                count += std::to_string(constant);
+                        }
+
+                        inform(gimple_location(first), "%d consecutive calls to %s with the same communicator, datatype and operation "
+                                        "could be fused into one of %s elements", (int) group.size(), mpi_collective_name[code], count.c_str());
+                        for (unsigned k = 1; k < group.size(); k++) {
+                                inform(gimple_location(group[k]), "fusion candidate %d of %d", k + 1, (int) group.size());
+                        }
+                }
+        }
+}
+
+/* Redundant barriers */
+
+/* Given by -fplugin-arg-libplugin-redundant-barriers[=remove] */
+enum barrier_mode {BARRIERS_IGNORED, BARRIERS_REPORTED, BARRIERS_REMOVED};
+static enum barrier_mode redundant_barriers = BARRIERS_IGNORED;
+
+/* returns true if a statement neither communicates nor has an effect visible outside of the process */
+static bool barrier_transparent(gimple *stmt, hash_set<gimple *> &redundant)
+{
+        return region_statement_is_plain(stmt) || redundant.contains(stmt);
+}
+
+/* returns true if every block on the paths from dom to bb, bb and dom excluded, is transparent */
+/* the paths are followed backward from bb, a path coming back to bb is a cycle and is refused */
+static bool barrier_path_transparent(basic_block bb, basic_block dom, bool forward, hash_set<gimple *> &redundant)
+{
+        bitmap_head visited;
+        bitmap_initialize(&visited, &mpicoll_obstack);
+        std::vector<basic_block> stack;
+        stack.push_back(bb);
+        bool transparent = true;
+
+        while (transparent && !stack.empty()) {
+                basic_block cur = stack.back();
+                stack.pop_back();
+                edge e;
+                edge_iterator ei;
+                FOR_EACH_EDGE(e, ei, forward ? cur -> succs : cur -> preds) {
+                        basic_block other = forward ? e -> dest : e -> src;
+                        if (other == dom) continue;
+                        if (other == bb || other -> index < NUM_FIXED_BLOCKS) {
+                                transparent = false;
+                                break;
+                        }
+                        if (!bitmap_set_bit(&visited, other -> index)) continue;
+                        for (gimple_stmt_iterator gsi = gsi_start_bb(other); !gsi_end_p(gsi); gsi_next(&gsi)) {
+                                if (!barrier_transparent(gsi_stmt(gsi), redundant)) transparent = false;
+                        }
+                        stack.push_back(other);
+                }
+        }
+        bitmap_clear(&visited);
+        return transparent;
+}
+
+/* returns the synchronizing collective on the communicator of the barrier that comes right before it */
+/* (forward: right after it) on every path, NULL if there is none or if a statement between them communicates */
+/* the collective is searched in the dominators (forward: post-dominators) of the block of the barrier */
+static gimple *barrier_witness(function *fun, gimple *barrier, bool forward, hash_set<gimple *> &redundant)
+{
+        tree comm = gimple_call_arg(barrier, mpi_collective_arg[MPI_BARRIER].comm);
+        basic_block bb = gimple_bb(barrier);
+        gimple_stmt_iterator gsi = gsi_for_stmt(barrier);
+        if (forward) gsi_next(&gsi);
+        else gsi_prev(&gsi);
+
+        while (true) {
+                if (gsi_end_p(gsi)) {
+                        basic_block dom = get_immediate_dominator(forward ? CDI_POST_DOMINATORS : CDI_DOMINATORS, bb);
+                        if (dom == NULL || dom -> index < NUM_FIXED_BLOCKS
+                            || !barrier_path_transparent(bb, dom, forward, redundant)) return NULL;
+                        bb = dom;
+                        gsi = forward ? gsi_start_bb(bb) : gsi_last_bb(bb);
+                        continue;
+                }
+                gimple *stmt = gsi_stmt(gsi);
+                if (forward) gsi_next(&gsi);
+                else gsi_prev(&gsi);
+                if (barrier_transparent(stmt, redundant)) continue;
+
+                int code = is_mpi_call(stmt);
+                if (code == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE || !(mpi_collective_flags[code] & MPICOLL_SYNCHRONIZING)) return NULL;
+                int comm_index = mpi_collective_arg[code].comm;
+                if (comm_index < 0 || (unsigned) comm_index >= gimple_call_num_args(stmt)
+                    || !operand_equal_p(gimple_call_arg(stmt, comm_index), comm, 0)) return NULL;
+                return stmt;
+        }
+}
+
+/* reports the barriers that come right before or right after a synchronizing collective on the same communicator */
+/* and removes them in the remove mode, returns the number of barriers removed */
+/* a redundant barrier is not a witness for another one, of two barriers in a row only one is redundant */
+int find_redundant_barriers(function *fun)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+        hash_set<gimple *> redundant;
+        std::vector<gimple *> removed;
+
+        bool computed_dominators = !dom_info_available_p(CDI_DOMINATORS);
+        bool computed_post_dominators = !dom_info_available_p(CDI_POST_DOMINATORS);
+        if (computed_dominators) calculate_dominance_info(CDI_DOMINATORS);
+        if (computed_post_dominators) calculate_dominance_info(CDI_POST_DOMINATORS);
+
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        if (is_mpi_call(stmt) != MPI_BARRIER || gimple_call_num_args(stmt) < 1) continue;
+
+                        bool dominated = true;
+                        gimple *witness = barrier_witness(fun, stmt, false, redundant);
+                        if (witness == NULL) {
+                                dominated = false;
+                                witness = barrier_witness(fun, stmt, true, redundant);
+                        }
+                        if (witness == NULL) continue;
+
+                        redundant.add(stmt);
+                        removed.push_back(stmt);
+                        if (redundant_barriers == BARRIERS_REMOVED) {
+                                inform(gimple_location(stmt), "redundant MPI_Barrier removed");
+                        }
+                        else {
+                                inform(gimple_location(stmt), "redundant MPI_Barrier, it has no effect");
+                        }
+                        inform(gimple_location(witness), "%s synchronizes the processes %s it without any communication in between",
+                                        mpi_collective_name[is_mpi_call(witness)], dominated ? "before" : "after");
+                }
+        }
+
+        /* the CFG is split after, split_block only keeps the dominators up to date */
+        if (computed_dominators) free_dominance_info(CDI_DOMINATORS);
+        if (computed_post_dominators) free_dominance_info(CDI_POST_DOMINATORS);
+        if (redundant_barriers != BARRIERS_REMOVED) return 0;
+
+        for (size_t k = 0; k < removed.size(); k++) {
+                gimple_stmt_iterator it = gsi_for_stmt(removed[k]);
+                tree lhs = gimple_call_lhs(removed[k]);
+                unlink_stmt_vdef(removed[k]);
+                /* the result of the barrier may be checked, it becomes MPI_SUCCESS, 0 in the standard */
+                if (lhs != NULL_TREE) {
+                        gassign *success = gimple_build_assign(lhs, build_int_cst(TREE_TYPE(lhs), 0));
+                        gimple_set_location(success, gimple_location(removed[k]));
+                        gsi_replace(&it, success, false);
+                        continue;
+                }
+                gsi_remove(&it, true);
+                if (gimple_in_ssa_p(fun)) release_defs(removed[k]);
+        }
+        code_changed = code_changed || !removed.empty();
+        return removed.size();
+}
+
+/* Analysis cache */
+
+/* Directory given by -fplugin-arg-libplugin-cache-dir=<dir>, NULL when the cache is disabled */
+/* each entry is a file named after the key of the function, the key is a hash of the CFG */
+/* after the split, of the collectives of each block and of the table of collectives */
+static const char *cache_directory;
+
+#define CACHE_MAGIC 0x4343504dU         /* "MPCC" */
+#define CACHE_FORMAT_VERSION 5
+
+/* Header of an entry, followed by the warnings, the summary sequence and the checks of the function */
+struct cache_entry_header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t nb_warnings;
+        uint32_t summary_state;         /* 0: no summary, 1: uniform, 2: not uniform */
+        uint32_t summary_length;
+        uint32_t nb_checks;             /* collectives checked at run time, after the summary sequence */
+};
+
+/* Key of the current function and whether its results have to be stored at the end of the analysis */
+static uint64_t cache_key;
+static bool cache_store_pending;
+
+/* adds bytes to a 64 bits FNV-1a hash */
+static void cache_hash(uint64_t *hash, const void *data, size_t size)
+{
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (size_t k = 0; k < size; k++) {
+                *hash ^= bytes[k];
+                *hash *= 0x100000001b3ULL;
+        }
+}
+
+static void cache_hash_int(uint64_t *hash, int value)
+{
+        cache_hash(hash, &value, sizeof(value));
+}
+
+/* Variables of the current function numbered in their order of appearance for the key, */
+/* their DECL_UID changes with the rest of the translation unit */
+struct cache_operand_state {
+        uint64_t *hash;
+        hash_map<tree, int> variables;
+};
+
+/* adds a node of an operand as the taint analysis sees it: the kind of the variables and the SSA names */
+static tree cache_hash_operand_r(tree *tp, int *walk_subtrees, void *data)
+{
+        cache_operand_state *state = (cache_operand_state *) data;
+        tree t = *tp;
+        cache_hash_int(state -> hash, TREE_CODE(t));
+        switch (TREE_CODE(t)) {
+        case SSA_NAME:
+                cache_hash_int(state -> hash, SSA_NAME_VERSION(t));
+                cache_hash_int(state -> hash, SSA_NAME_IS_DEFAULT_DEF(t));
+                *walk_subtrees = 0;
+                break;
+        case VAR_DECL:
+        case PARM_DECL:
+        case RESULT_DECL: {
+                bool existed;
+                int &number = state -> variables.get_or_insert(t, &existed);
+                if (!existed) number = state -> variables.elements() - 1;
+                cache_hash_int(state -> hash, number);
+                cache_hash_int(state -> hash, is_global_var(t));
+                cache_hash_int(state -> hash, TREE_ADDRESSABLE(t));
+                *walk_subtrees = 0;
+                break;
+        }
+        default:
+                if (TYPE_P(t) || DECL_P(t) || CONSTANT_CLASS_P(t)) *walk_subtrees = 0;
+                break;
+        }
+        return NULL_TREE;
+}
+
+static void cache_hash_operand(cache_operand_state *state, tree op)
+{
+        if (op == NULL_TREE) {
+                cache_hash_int(state -> hash, -1);
+                return;
+        }
+        walk_tree_without_duplicates(&op, cache_hash_operand_r, state);
+}
+
+/* computes the key of the current function, the result of the analysis only depends on the edges */
+/* of the CFG and on the statements executing collectives, so the statements are hashed by their kind and class */
+static uint64_t cache_compute_key(function *fun)
+{
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        basic_block bb;
+
+        cache_hash_int(&hash, CACHE_FORMAT_VERSION);
+        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) {
+                cache_hash(&hash, mpi_collective_name[i], strlen(mpi_collective_name[i]) + 1);
+                cache_hash_int(&hash, mpi_collective_flags[i]);
+        }
+
+        /* the forks that may depend on the process are found from the operands of the statements */
+        /* the loop summaries follow from them and from the CFG */
+        cache_hash_int(&hash, all_forks);
+        cache_hash_int(&hash, instrument_enabled && final_run);
+        cache_operand_state operands;
+        operands.hash = &hash;
+
+        cache_hash_int(&hash, nb_collective_classes);
+        for (int i=0; i < nb_collective_classes; i++) {
+                cache_hash_int(&hash, collective_classes[i].code);
+                cache_hash_int(&hash, collective_classes[i].comm != NULL_TREE);
+        }
+
+        cache_hash_int(&hash, last_basic_block_for_fn(fun));
+        FOR_ALL_BB_FN(bb, fun) {
+                cache_hash_int(&hash, bb -> index);
+
+                if (!all_forks) {
+                        for (gphi_iterator gpi = gsi_start_phis(bb); !gsi_end_p(gpi); gsi_next(&gpi)) {
+                                gphi *phi = gpi.phi();
+                                cache_hash_operand(&operands, gimple_phi_result(phi));
+                                for (unsigned k = 0; k < gimple_phi_num_args(phi); k++) cache_hash_operand(&operands, gimple_phi_arg_def(phi, k));
+                        }
+                }
+
+                gimple_stmt_iterator gsi;
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        collective_summary *summary = summary_of_call(stmt);
+                        cache_hash_int(&hash, gimple_code(stmt));
+                        if (!all_forks) {
+                                for (unsigned k = 0; k < gimple_num_ops(stmt); k++) cache_hash_operand(&operands, gimple_op(stmt, k));
+                                if (is_gimple_call(stmt)) cache_hash_int(&hash, (gimple_call_flags(stmt) & ECF_CONST) != 0);
+                        }
+                        cache_hash_int(&hash, is_mpi_call(stmt));
+                        if (is_mpi_call(stmt) != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) {
+                                cache_hash_int(&hash, class_of_collective(stmt, is_mpi_call(stmt)));
+                        }
+                        if (summary != NULL) {
+                                cache_hash_int(&hash, summary -> sequence.size());
+                                for (size_t k = 0; k < summary -> sequence.size(); k++) cache_hash_int(&hash, summary -> sequence[k]);
+                        }
+                }
+
+                edge e;
+                edge_iterator it;
+                cache_hash_int(&hash, EDGE_COUNT(bb -> succs));
+                FOR_EACH_EDGE(e, it, bb -> succs) {
+                        cache_hash_int(&hash, e -> dest -> index);
+                }
+        }
+        return hash;
+}
+
+/* builds the name of the entry of a key */
+static void cache_entry_filename(uint64_t key, char *filename, size_t size)
+{
+        snprintf(filename, size, "%s/%016llx.mpicoll", cache_directory, (unsigned long long) key);
+}
+
+/* looks the current function up in the cache and replays its warnings on a hit */
+/* on a miss, the results of the analysis are stored by finish_analysis */
+bool cache_lookup(function *fun)
+{
+        char filename[1024];
+
+        cache_key = cache_compute_key(fun);
+        cache_entry_filename(cache_key, filename, sizeof(filename));
+        cache_store_pending = true;
+
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(cache_entry_header)) {
+                map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (map == MAP_FAILED) return false;
+
+        const cache_entry_header *header = (const cache_entry_header *) map;
+        const mpicoll_warning *warnings = (const mpicoll_warning *) (header + 1);
+        const uint32_t *sequence = (const uint32_t *) (warnings + header -> nb_warnings);
+        const mpicoll_check *checks = (const mpicoll_check *) (sequence + header -> summary_length);
+
+        /* a truncated or foreign entry is a miss, it is overwritten at the end of the analysis */
+        if (header -> magic != CACHE_MAGIC || header -> version != CACHE_FORMAT_VERSION || header -> key != cache_key
+            || (size_t) st.st_size != sizeof(cache_entry_header) + header -> nb_warnings * sizeof(mpicoll_warning)
+                                      + header -> summary_length * sizeof(uint32_t) + header -> nb_checks * sizeof(mpicoll_check)) {
+                munmap(map, st.st_size);
+                return false;
+        }
+        cache_store_pending = false;
+
+        for (uint32_t k = 0; k < header -> nb_warnings; k++) {
+                if (warnings[k].block >= (unsigned int) last_basic_block_for_fn(fun) || warnings[k].code >= (unsigned int) nb_collective_classes) continue;
+                if (warnings[k].kind == WARNING_COLLECTIVE) warn_collectives_in_block(fun, warnings[k].block, warnings[k].code);
+                else warn_fork(fun, warnings[k].block);
+        }
+        if (header -> nb_warnings == 0) printf("No potential deadlock found.\n");
+
+        for (uint32_t k = 0; k < header -> nb_checks; k++) {
+                if (checks[k].block >= (unsigned int) last_basic_block_for_fn(fun) || checks[k].code >= (unsigned int) nb_collective_classes) continue;
+                instrumented_checks.push_back(checks[k]);
+        }
+
+        /* the summary of the function is not computed again if it is called */
+        if (header -> summary_state != 0) {
+                if (summary_index == NULL) summary_index = new hash_map<int_hash<unsigned int, UINT_MAX>, int>;
+                if (summary_index -> get(DECL_UID(fun -> decl)) == NULL) {
+                        collective_summary *summary = new collective_summary;
+                        summary -> uniform = header -> summary_state == 1;
+                        summary -> complete = true;
+                        memset(summary -> counts, 0, sizeof(summary -> counts));
+                        for (uint32_t k = 0; k < header -> summary_length; k++) {
+                                if (sequence[k] >= LAST_AND_UNUSED_MPI_COLLECTIVE_CODE) continue;
+                                summary -> sequence.push_back(sequence[k]);
+                                summary -> counts[sequence[k]]++;
+                        }
+                        summary_index -> put(DECL_UID(fun -> decl), summaries.size());
+                        summaries.push_back(summary);
+                }
+        }
+
+        munmap(map, st.st_size);
+        return true;
+}
+
+/* stores the warnings printed for the current function and its summary in the cache */
+/* the entry is written in a temporary file and renamed, parallel compilations never read a partial entry */
+void cache_store(function *fun)
+{
+        char filename[1024];
+        char temporary[1100];
+
+        cache_store_pending = false;
+
+        cache_entry_header header;
+        memset(&header, 0, sizeof(header));
+        header.magic = CACHE_MAGIC;
+        header.version = CACHE_FORMAT_VERSION;
+        header.key = cache_key;
+        header.nb_warnings = printed_warnings.size();
+        header.nb_checks = instrumented_checks.size();
+
+        std::vector <uint32_t> sequence;
+        int s = collective_summary_of_decl(fun -> decl);
+        if (s >= 0) {
+                header.summary_state = summaries[s] -> uniform ? 1 : 2;
+                sequence.assign(summaries[s] -> sequence.begin(), summaries[s] -> sequence.end());
+                header.summary_length = sequence.size();
+        }
+
+        cache_entry_filename(cache_key, filename, sizeof(filename));
+        snprintf(temporary, sizeof(temporary), "%s.%d", filename, (int) getpid());
+
+        FILE *out = fopen(temporary, "wb");
+        if (out == NULL) {
+                warning(0, "cannot write cache entry %s: %m", temporary);
+                return;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, out) == 1
+                && fwrite(printed_warnings.data(), sizeof(mpicoll_warning), printed_warnings.size(), out) == printed_warnings.size()
+                && fwrite(sequence.data(), sizeof(uint32_t), sequence.size(), out) == sequence.size()
+                && fwrite(instrumented_checks.data(), sizeof(mpicoll_check), instrumented_checks.size(), out) == instrumented_checks.size();
+        if (fclose(out) != 0) written = false;
+
+        if (!written || rename(temporary, filename) != 0) {
+                warning(0, "cannot write cache entry %s: %m", filename);
+                unlink(temporary);
+        }
+}
+
+/* Pragma Handling  */
+
+/* Functions listed in the pragmas, keyed by identifier node, with their position in the pragmas */
+/* the registry is kept for every placement of the pass, the examined functions are in pragma_functions_seen */
+static hash_map<tree, unsigned> *pragma_functions;
+static unsigned nb_pragma_functions;
+
+/* Listed functions examined by the pass, the others are reported at the end of the translation unit */
+static hash_set<tree> *pragma_functions_seen;
+
+/* Patterns given to mpicoll_check_match and the number of functions each one matched */
+static std::vector<const char *> pragma_patterns;
+static std::vector<int> pragma_pattern_matches;
+
+bool is_function_in_pragma_list(tree fname) {
+        return pragma_functions != NULL && pragma_functions -> get(fname) != NULL;
+}
+
+/* marks a listed function as defined, the registry keeps it for the other placements of the pass */
+bool mark_pragma_function_seen(tree fname) {
+        if (!is_function_in_pragma_list(fname)) return false;
+        if (pragma_functions_seen == NULL) pragma_functions_seen = new hash_set<tree>;
+        pragma_functions_seen -> add(fname);
+        return true;
+}
+
+/* matches a name against a pattern where '*' is any sequence of characters and '?' any character */
+static bool pattern_match(const char *pattern, const char *name) {
+        const char *star = NULL; /* position of the last '*' in the pattern */
+        const char *retry = NULL; /* position in the name where that '*' matching resumes */
+
+        while (*name) {
+                if (*pattern == '*') {
+                        star = pattern++;
+                        retry = name;
+                }
+                else if (*pattern == '?' || *pattern == *name) {
+                        pattern++;
+                        name++;
+                }
+                else if (star) {
+                        pattern = star + 1;
+                        name = ++retry;
+                }
+                else return false;
+        }
+        while (*pattern == '*') pattern++;
+        return *pattern == '\0';
+}
+
+bool is_function_matching_pragma_pattern(const char *fname) {
+        bool matched = false;
+        for (unsigned i = 0; i < pragma_patterns.size(); i++) {
+                if (pattern_match(pragma_patterns[i], fname)) {
+                        pragma_pattern_matches[i]++;
+                        matched = true;
+                }
+        }
+        return matched;
+}
+
+/* returns true if the function is selected by a pragma or by the mpicoll_check attribute */
+bool is_function_checked(tree fndecl) {
+        bool listed = mark_pragma_function_seen(DECL_NAME(fndecl));
+        bool matched = is_function_matching_pragma_pattern(IDENTIFIER_POINTER(DECL_NAME(fndecl)));
+        bool attribute = lookup_attribute("mpicoll_check", DECL_ATTRIBUTES(fndecl)) != NULL_TREE;
+        return listed || matched || attribute;
+}
+
+static void handle_arg(tree pragma_arg) {
+        const char *func_name = IDENTIFIER_POINTER(pragma_arg);
+        if (pragma_functions == NULL) pragma_functions = new hash_map<tree, unsigned>;
+        if (is_function_in_pragma_list(pragma_arg)) {
+                warning(0, "%<#pragma ProjetCA mpicoll_check%> function '%s' appears multiple times", func_name);
+        } else {
+                pragma_functions -> put(pragma_arg, nb_pragma_functions++);
+        }
+}
+
+static void
+handle_pragma_fx(cpp_reader *dummy ATTRIBUTE_UNUSED)
+{
+        enum cpp_ttype token;
+        bool close_paren_needed = false;
+        tree pragma_arg;
+                
+        if (cfun) {
+                error("%<#pragma ProjetCA mpicoll_check%> pragma not allowed inside a function definition");
+                return;
+        }
+
+        token = pragma_lex(&pragma_arg);
+        if (CPP_OPEN_PAREN == token) {
+                close_paren_needed = true;
+                token = pragma_lex(&pragma_arg);
+                if (CPP_NAME != token) {
+                error("%<#pragma ProjetCA mpicoll_check%> argument is not a name");
+                return;
+                }
+                
+                handle_arg(pragma_arg);
+                
+                token = pragma_lex(&pragma_arg);
+                if (token == CPP_NAME) {
+                        error("%<#pragma ProjetCA mpicoll_check%> list must be separated by commas");
+                        return;
+                }
+                while (CPP_COMMA == token) {
+                token = pragma_lex(&pragma_arg);
+                if (CPP_NAME != token) {
+                        error("%<#pragma ProjetCA mpicoll_check%> argument is not a name");
+                        return;
+                }
+                handle_arg(pragma_arg);
+                token = pragma_lex(&pragma_arg);
+                }
+        } else if (CPP_NAME == token) {
+                handle_arg(pragma_arg);
+                token = pragma_lex(&pragma_arg);
+        }else {
+                error("%<#pragma ProjetCA mpicoll_check%> argument is not a name");
+                return;
+        }
+
+        if (CPP_CLOSE_PAREN == token) {
+                if (!close_paren_needed) {
+                error("%<#pragma ProjetCA mpicoll_check%> unexpected closing perenthesis");
+                return;
+                }
+                close_paren_needed = false;
+                token = pragma_lex(&pragma_arg);
+        }
+
+        if (CPP_EOF == token) {
+                if (close_paren_needed) {
+                error("%<#pragma ProjetCA mpicoll_check%> missing closing perenthesis");
+                }
+        }
+        else {
+                error("%<#pragma ProjetCA mpicoll_check%> expected parenthesis for list");
+                return;
+        }
+
+}
+
+static void handle_pattern(tree pragma_arg) {
+        pragma_patterns.push_back(xstrdup(TREE_STRING_POINTER(pragma_arg)));
+        pragma_pattern_matches.push_back(0);
+}
+
+static void
+handle_pragma_match(cpp_reader *dummy ATTRIBUTE_UNUSED)
+{
+        enum cpp_ttype token;
+        bool close_paren_needed = false;
+        tree pragma_arg;
+
+        if (cfun) {
+                error("%<#pragma ProjetCA mpicoll_check_match%> pragma not allowed inside a function definition");
+                return;
+        }
+
+        token = pragma_lex(&pragma_arg);
+        if (CPP_OPEN_PAREN == token) {
+                close_paren_needed = true;
+                token = pragma_lex(&pragma_arg);
+        }
+        if (CPP_STRING != token) {
+                error("%<#pragma ProjetCA mpicoll_check_match%> argument is not a string");
+                return;
+        }
+        handle_pattern(pragma_arg);
+        token = pragma_lex(&pragma_arg);
+        while (CPP_COMMA == token) {
+                token = pragma_lex(&pragma_arg);
+                if (CPP_STRING != token) {
+                        error("%<#pragma ProjetCA mpicoll_check_match%> argument is not a string");
+                        return;
+                }
+                handle_pattern(pragma_arg);
+                token = pragma_lex(&pragma_arg);
+        }
+
+        if (CPP_CLOSE_PAREN == token) {
+                if (!close_paren_needed) {
+                        error("%<#pragma ProjetCA mpicoll_check_match%> unexpected closing perenthesis");
+                        return;
+                }
+                close_paren_needed = false;
+                token = pragma_lex(&pragma_arg);
+        }
+
+        if (CPP_EOF == token) {
+                if (close_paren_needed) {
+                        error("%<#pragma ProjetCA mpicoll_check_match%> missing closing perenthesis");
+                }
+        }
+        else {
+                error("%<#pragma ProjetCA mpicoll_check_match%> expected parenthesis for list");
+        }
+}
+
+/* the mpicoll_check attribute selects a function like the pragma does */
+static tree
+handle_mpicoll_check_attribute(tree *node, tree name, tree args ATTRIBUTE_UNUSED, int flags ATTRIBUTE_UNUSED, bool *no_add_attrs)
+{
+        if (TREE_CODE(*node) != FUNCTION_DECL) {
+                warning(0, "%qE attribute only applies to functions", name);
+                *no_add_attrs = true;
+        }
+        return NULL_TREE;
+}
+
+static struct attribute_spec mpicoll_check_attribute =
+{
+        "mpicoll_check", /* name */
+        0, /* min_length */
+        0, /* max_length */
+        true, /* decl_required */
+        false, /* type_required */
+        false, /* function_type_required */
+        false, /* affects_type_identity */
+        handle_mpicoll_check_attribute, /* handler */
+        NULL, /* exclude */
+};
+
+void register_attributes(void *event_data, void *data) {
+        register_attribute(&mpicoll_check_attribute);
+}
+
+/* the identifiers of the registry are not referenced by the GC roots once parsing is done */
+void mark_pragma_functions(void *event_data, void *data) {
+        if (pragma_functions == NULL) return;
+        for (hash_map<tree, unsigned>::iterator it = pragma_functions -> begin(); it != pragma_functions -> end(); ++it) {
+                ggc_set_mark((*it).first);
+        }
+}
+
+void not_declared_functions(void *event_data, void *data) {
+	/* the remaining functions are reported in the order of the pragmas */
+        if (pragma_functions != NULL) {
+                tree *remaining = XCNEWVEC(tree, nb_pragma_functions);
+                for (hash_map<tree, unsigned>::iterator it = pragma_functions -> begin(); it != pragma_functions -> end(); ++it) {
+                        if (pragma_functions_seen != NULL && pragma_functions_seen -> contains((*it).first)) continue;
+                        remaining[(*it).second] = (*it).first;
+                }
+                for (unsigned i = 0; i < nb_pragma_functions; i++) {
+                        if (remaining[i] == NULL_TREE) continue;
+                        const char* func_name = IDENTIFIER_POINTER(remaining[i]);
+                        location_t loc = UNKNOWN_LOCATION;
+                        warning_at(loc, 0, "%<#pragma ProjetCA mpicoll_check%> function '%s' is not declared but referenced in pragma", func_name);
+                }
+                XDELETEVEC(remaining);
+        }
+        for (unsigned i = 0; i < pragma_patterns.size(); i++) {
+                if (pragma_pattern_matches[i] == 0) {
+                        warning_at(UNKNOWN_LOCATION, 0, "%<#pragma ProjetCA mpicoll_check_match%> pattern '%s' does not match any function", pragma_patterns[i]);
+                }
+        }
+}
+
+/* Graphviz */
+
+/* Stages of the analysis at which the CFG can be dumped */
+enum cfgviz_stage {
+        CFGVIZ_INITIAL,
+        CFGVIZ_SPLIT,
+        CFGVIZ_INVALID_EDGES,
+        LAST_AND_UNUSED_CFGVIZ_STAGE
+} ;
+
+const char *const cfgviz_stage_name[] = { "initial", "split", "invalid_edges" } ;
+
+/* Stages selected by -fplugin-arg-libplugin-graph=<stage>[,<stage>...] (or all), none by default */
+static bool cfgviz_stages[LAST_AND_UNUSED_CFGVIZ_STAGE];
+
+/* Output directory given by -fplugin-arg-libplugin-graph-dir=<dir> */
+static const char *cfgviz_directory = "graph";
+
+/* Format given by -fplugin-arg-libplugin-graph-format=dot|json */
+static bool cfgviz_json;
+
+/* Size of the buffer of the graph files, a graph is written with a single write most of the time */
+#define CFGVIZ_BUFFER_SIZE (1 << 16)
+
+/* returns false if the list of stages given to the graph argument is not valid */
+static bool cfgviz_select_stages(const char *list)
+{
+        while (*list) {
+                const char *end = strchr(list, ',');
+                size_t len = end ? (size_t) (end - list) : strlen(list);
+                bool found = false;
+
+                if (len == 3 && strncmp(list, "all", 3) == 0) {
+                        for (int i = 0; i < LAST_AND_UNUSED_CFGVIZ_STAGE; i++) cfgviz_stages[i] = true;
+                        found = true;
+                }
+                for (int i = 0; i < LAST_AND_UNUSED_CFGVIZ_STAGE; i++) {
+                        if (strlen(cfgviz_stage_name[i]) == len && strncmp(list, cfgviz_stage_name[i], len) == 0) {
+                                cfgviz_stages[i] = true;
+                                found = true;
+                        }
+                }
+                if (!found) return false;
+                list += len;
+                if (*list == ',') list++;
+        }
+        return true;
+}
+
+/* writes a string as a JSON string */
+static void json_print_string(FILE *out, const char *str)
+{
+        fputc('"', out);
+        for (; *str; str++) {
+                /* the control characters are not allowed in a JSON string */
+                if ((unsigned char) *str < 0x20) {
+                        fprintf(out, "\\u%04x", (unsigned char) *str);
+                        continue;
+                }
+                if (*str == '"' || *str == '\\') fputc('\\', out);
+                fputc(*str, out);
+        }
+        fputc('"', out);
+}
+
+/* Build a filename based on function name, in a buffer of the given size */
+static void cfgviz_generate_filename( function * fun, const char * suffix, char * target_filename, size_t size )
+{
+	snprintf( target_filename, size, "%s/%s_%s_%d_%s.%s",
+			cfgviz_directory,
+			current_function_name(),
+			lbasename( LOCATION_FILE( fun->function_start_locus ) ),
+			LOCATION_LINE( fun->function_start_locus ),
+			suffix,
+			cfgviz_json ? "json" : "dot" ) ;
+}
+
+/* returns the label of an edge of a condition */
+static const char *cfgviz_edge_label( edge e )
+{
+	if( e->flags == EDGE_TRUE_VALUE )
+		return "true";
+	else if( e->flags == EDGE_FALSE_VALUE )
+		return "false";
+	return "";
+}
+
+/* Dump the graphviz representation of function 'fun' in file 'out' */
+static void cfgviz_internal_dump( function * fun, FILE * out, bitmap valid_edges)
+{
+	basic_block bb;
+	// Print the header line and open the main graph
+	fprintf(out, "Digraph G{\n");
+
+	FOR_ALL_BB_FN(bb, fun)
 	{
 		fprintf( out,"%d [label=\"BB %d", bb->index,	bb->index);
 
 		gimple_stmt_iterator gsi;
 		gimple * stmt;
-		gsi = gsi_start_bb(bb);
-		stmt = gsi_stmt(gsi);
 	
 		for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi))
 		{
 
 			stmt = gsi_stmt(gsi);
 
-			enum mpi_collective_code returned_code ;
-
-			returned_code = LAST_AND_UNUSED_MPI_COLLECTIVE_CODE ;
-
-			if (is_gimple_call (stmt))
-			{
-				tree t ;
-				const char * callee_name ;
-				int i ;
-				bool found = false ;
-
-				t = gimple_call_fndecl( stmt ) ;
-				callee_name = IDENTIFIER_POINTER(DECL_NAME(t)) ;
-
-				i = 0 ;
-				while ( !found && i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE )
-				{
-					if ( strncmp( callee_name, mpi_collective_name[i], strlen(
-									mpi_collective_name[i] ) ) == 0 )
-					{
-						found = true ;
-						returned_code = (enum mpi_collective_code) i ;
-					}
-					i++ ;
-				} 
-
-			}
-
+			int returned_code = is_mpi_call( stmt ) ;
+			collective_summary * summary = summary_of_call( stmt ) ;
 
 			if ( returned_code != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE )
 			{
 				fprintf( out, " \\n %s", mpi_collective_name[returned_code] ) ;
 			}
+			else if ( summary != NULL )
+			{
+				fprintf( out, " \\n %s (", fndecl_name( gimple_call_fndecl( stmt ) ) ) ;
+				for ( size_t k = 0 ; k < summary->sequence.size() ; k++ )
+					fprintf( out, "%s%s", k ? ", " : "", mpi_collective_name[summary->sequence[k]] ) ;
+				fprintf( out, ")" ) ;
+			}
 		}
 
 		fprintf(out, "\" shape=ellipse]\n");
@@ -755,11 +2697,7 @@ static void cfgviz_internal_dump( function * fun, FILE * out, bitmap valid_edges
 			{
 				exist=0;
 			}
-			const char *label = "";
-			if( e->flags == EDGE_TRUE_VALUE )
-				label = "true";
-			else if( e->flags == EDGE_FALSE_VALUE )
-				label = "false";
+			const char *label = cfgviz_edge_label( e );
 			if (valid_edges != NULL)
 			{
 				fprintf( out, "%d -> %d [color=%s label=\"%s\"]\n",
@@ -770,19 +2708,84 @@ static void cfgviz_internal_dump( function * fun, FILE * out, bitmap valid_edges
 				fprintf( out, "%d -> %d [color=%s label=\"%s\"]\n",
 						bb->index, e->dest->index, exist ? "blue" : "red", label ) ;
 			}
+			i++;
 		}
 	}
 	
 	fprintf(out, "}\n");
 }
 
+/* Dump the edge list of function 'fun' in JSON in file 'out' */
+static void cfgviz_internal_dump_json( function * fun, FILE * out, const char * suffix, bitmap invalid_edges)
+{
+	basic_block bb;
+
+	fprintf( out, "{\"function\": " ) ;
+	json_print_string( out, current_function_name() ) ;
+	fprintf( out, ", \"file\": " ) ;
+	json_print_string( out, LOCATION_FILE( fun->function_start_locus ) ) ;
+	fprintf( out, ", \"line\": %d, \"stage\": \"%s\",\n \"blocks\": [",
+			LOCATION_LINE( fun->function_start_locus ), suffix ) ;
+
+	bool first = true;
+	FOR_ALL_BB_FN(bb, fun)
+	{
+		fprintf( out, "%s\n  {\"index\": %d, \"collectives\": [", first ? "" : ",", bb->index ) ;
+		first = false;
+
+		bool first_coll = true;
+		gimple_stmt_iterator gsi;
+		for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi))
+		{
+			int returned_code = is_mpi_call( gsi_stmt(gsi) ) ;
+			collective_summary * summary = summary_of_call( gsi_stmt(gsi) ) ;
+			if ( returned_code != LAST_AND_UNUSED_MPI_COLLECTIVE_CODE )
+			{
+				fprintf( out, "%s\"%s\"", first_coll ? "" : ", ", mpi_collective_name[returned_code] ) ;
+				first_coll = false;
+			}
+			else if ( summary != NULL )
+			{
+				for ( size_t k = 0 ; k < summary->sequence.size() ; k++ )
+				{
+					fprintf( out, "%s\"%s\"", first_coll ? "" : ", ", mpi_collective_name[summary->sequence[k]] ) ;
+					first_coll = false;
+				}
+			}
+		}
+		fprintf( out, "]}" ) ;
+	}
+
+	fprintf( out, "],\n \"edges\": [" ) ;
+	first = true;
+	FOR_ALL_BB_FN(bb, fun)
+	{
+		edge_iterator eit;
+		edge e;
+		int i = 0;
+		FOR_EACH_EDGE( e, eit, bb->succs )
+		{
+			bool invalid = invalid_edges != NULL && bitmap_bit_p(&invalid_edges[bb->index], i);
+			fprintf( out, "%s\n  [%d, %d, \"%s\", %s]", first ? "" : ",",
+					bb->index, e->dest->index, cfgviz_edge_label( e ), invalid ? "true" : "false" ) ;
+			first = false;
+			i++;
+		}
+	}
+	fprintf( out, "]}\n" ) ;
+}
+
 void 
-cfgviz_dump( function * fun, const char * suffix, bitmap valid_edges=NULL)
+cfgviz_dump( function * fun, enum cfgviz_stage stage, bitmap valid_edges=NULL)
 {
-	char * target_filename ; 
+	char target_filename[1024] ;
 	FILE * out ;
 
-	target_filename = cfgviz_generate_filename( fun, suffix ) ;
+	if ( !cfgviz_stages[stage] )
+		return ;
+
+	phase_start(PHASE_GRAPHVIZ);
+	cfgviz_generate_filename( fun, cfgviz_stage_name[stage], target_filename, sizeof( target_filename ) ) ;
 	
 	#ifdef DEBUG
 	printf( "[GRAPHVIZ] Generating CFG of function %s in file <%s>\n",
@@ -790,23 +2793,656 @@ cfgviz_dump( function * fun, const char * suffix, bitmap valid_edges=NULL)
 	#endif
 	
 	out = fopen( target_filename, "w" ) ;
+	if ( out == NULL )
+	{
+		warning( 0, "cannot open graph file %s: %m", target_filename ) ;
+		phase_stop(PHASE_GRAPHVIZ);
+		return ;
+	}
+	setvbuf( out, NULL, _IOFBF, CFGVIZ_BUFFER_SIZE ) ;
 
-	cfgviz_internal_dump( fun, out, valid_edges ) ;
+	if ( cfgviz_json )
+		cfgviz_internal_dump_json( fun, out, cfgviz_stage_name[stage], valid_edges ) ;
+	else
+		cfgviz_internal_dump( fun, out, valid_edges ) ;
 
 	fclose( out ) ;
-	free( target_filename ) ;
+	phase_stop(PHASE_GRAPHVIZ);
 }
 
 
 static std::vector<tree> decl_funs;
 
+/* Statistics */
+
+/* writes the statistics of the analysis of the function as one JSON object per line */
+static void stats_dump(function *fun, int nb_collectives)
+{
+        int max_rank = 0;
+        if (block_ranks != NULL) {
+                int *ranks = ranks_of_block(EXIT_BLOCK_PTR_FOR_FN(fun) -> index);
+                for (int i=0; i < nb_collective_classes; i++) {
+                        if (ranks[i] > max_rank) max_rank = ranks[i];
+                }
+        }
+
+        fprintf(stats_file, "{\"function\": ");
+        json_print_string(stats_file, function_name(fun));
+        fprintf(stats_file, ", \"file\": ");
+        json_print_string(stats_file, LOCATION_FILE(fun -> function_start_locus));
+        fprintf(stats_file, ", \"line\": %d, \"blocks\": %d, \"collectives\": %d, \"max_rank\": %d, \"loops\": %d, \"bitmap_memory\": %ld, \"time_us\": {",
+                LOCATION_LINE(fun -> function_start_locus), n_basic_blocks_for_fn(fun), nb_collectives, max_rank, nb_summarized_loops,
+                (long) obstack_memory_used(&mpicoll_obstack.obstack));
+        for (int i=0; i < LAST_AND_UNUSED_MPICOLL_PHASE; i++) {
+                fprintf(stats_file, "%s\"%s\": %ld", i ? ", " : "", mpicoll_phase_name[i], phase_time[i]);
+        }
+        fprintf(stats_file, "}}\n");
+        fflush(stats_file);
+}
+
+void close_stats_file(void *event_data, void *data) {
+        if (stats_file) fclose(stats_file);
+        stats_file = NULL;
+}
+
+/* Runtime verification */
+
+/* Given by -fplugin-arg-libplugin-instrument, the collectives of the sets with a non-empty iterated */
+/* post-dominance frontier are preceded by a call to mpicoll_rt_check (src/mpicoll_rt.c) */
+static bool instrument_enabled;
+
+/* Declarations of mpicoll_rt_check and of mpicoll_rt_check_world, one of each per translation unit */
+static tree instrument_comm_decl;
+static tree instrument_world_decl;
+
+/* the declarations are kept by the garbage collector */
+void mark_instrument_decls(void *event_data, void *data)
+{
+        if (instrument_comm_decl != NULL_TREE) ggc_set_mark(instrument_comm_decl);
+        if (instrument_world_decl != NULL_TREE) ggc_set_mark(instrument_world_decl);
+}
+
+/* returns the type of the communicator parameter of the collective, the one of MPI_Comm */
+/* the argument itself may have another type: the conversion of &ompi_mpi_comm_world is dropped by GIMPLE */
+static tree instrument_comm_type(gimple *stmt, int comm_index)
+{
+        tree args = TYPE_ARG_TYPES(gimple_call_fntype(stmt));
+        for (int k = 0; k < comm_index && args != NULL_TREE; k++) args = TREE_CHAIN(args);
+        if (args != NULL_TREE && TREE_VALUE(args) != void_type_node) return TYPE_MAIN_VARIANT(TREE_VALUE(args));
+        return TYPE_MAIN_VARIANT(TREE_TYPE(gimple_call_arg(stmt, comm_index)));
+}
+
+/* returns the declaration of the check taking a communicator, NULL_TREE for mpicoll_rt_check_world */
+/* the communicator type is the one of the first collective checked */
+static tree instrument_decl(tree comm_type)
+{
+        if (comm_type == NULL_TREE) {
+                if (instrument_world_decl == NULL_TREE) {
+                        tree type = build_function_type_list(void_type_node, long_unsigned_type_node, const_ptr_type_node, NULL_TREE);
+                        instrument_world_decl = build_fn_decl("mpicoll_rt_check_world", type);
+                }
+                return instrument_world_decl;
+        }
+
+        if (instrument_comm_decl == NULL_TREE) {
+                tree type = build_function_type_list(void_type_node, long_unsigned_type_node, const_ptr_type_node, comm_type, NULL_TREE);
+                instrument_comm_decl = build_fn_decl("mpicoll_rt_check", type);
+        }
+        return instrument_comm_decl;
+}
+
+/* inserts the check before a collective, the hash identifies the collective and its call site */
+static void instrument_collective(gimple *stmt, int code)
+{
+        char site[256];
+        expanded_location loc = expand_location(gimple_location(stmt));
+        snprintf(site, sizeof(site), "%s at %s:%d:%d", mpi_collective_name[code],
+                        loc.file ? loc.file : "<unknown>", loc.line, loc.column);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        cache_hash(&hash, site, strlen(site));
+
+        tree hash_cst = build_int_cst(long_unsigned_type_node, (HOST_WIDE_INT) hash);
+        tree site_str = build_string_literal(strlen(site) + 1, site);
+        int comm_index = mpi_collective_arg[code].comm;
+        gcall *check;
+        gimple_stmt_iterator gsi = gsi_for_stmt(stmt);
+        if (comm_index >= 0 && (unsigned) comm_index < gimple_call_num_args(stmt)) {
+                tree decl = instrument_decl(instrument_comm_type(stmt, comm_index));
+                tree comm_type = TREE_VALUE(TREE_CHAIN(TREE_CHAIN(TYPE_ARG_TYPES(TREE_TYPE(decl)))));
+                tree comm = fold_convert(comm_type, unshare_expr(gimple_call_arg(stmt, comm_index)));
+                comm = force_gimple_operand_gsi(&gsi, comm, true, NULL_TREE, true, GSI_SAME_STMT);
+                check = gimple_build_call(decl, 3, hash_cst, site_str, comm);
+        }
+        else {
+                check = gimple_build_call(instrument_decl(NULL_TREE), 2, hash_cst, site_str);
+        }
+        gimple_set_location(check, gimple_location(stmt));
+        gsi_insert_before(&gsi, check, GSI_SAME_STMT);
+        code_changed = true;
+}
+
+int instrument_checks(function *fun);
+
+/* instruments the collectives of the sets the analysis could not prove, returns the number of checks */
+/* MPI_Init is not checked, the runtime cannot communicate before it */
+/* the checks are kept by class and block in instrumented_checks, a cache hit inserts them again */
+int instrument_collectives(function *fun, bitmap_head **iterated_pdf, bitmap_head **set)
+{
+        basic_block last = EXIT_BLOCK_PTR_FOR_FN(fun);
+        int *ranks = ranks_of_block(last -> index);
+        hash_set<int_hash<unsigned int, UINT_MAX> > checked;
+
+        for (int i = 0; i < nb_collective_classes; i++) {
+                int code = collective_classes[i].code;
+                if (code == MPI_INIT) continue;
+                for (int j = 0; j < ranks[i]; j++) {
+                        if (bitmap_empty_p(&iterated_pdf[i][j])) continue;
+                        bitmap_iterator bi;
+                        unsigned k;
+                        EXECUTE_IF_SET_IN_BITMAP(&set[i][j], 0, k, bi) {
+                                std::vector <basic_block> blocks = blocks_of_counts(fun, k);
+                                for (size_t b = 0; b < blocks.size(); b++) {
+                                        mpicoll_check check = { (unsigned int) i, (unsigned int) blocks[b] -> index };
+                                        if (!checked.add(check.block * nb_collective_classes + check.code)) instrumented_checks.push_back(check);
+                                }
+                        }
+                }
+        }
+        return instrument_checks(fun);
+}
+
+/* inserts the checks of instrumented_checks before their collectives, returns the number of checks */
+int instrument_checks(function *fun)
+{
+        hash_set<gimple *> instrumented;
+
+        for (size_t c = 0; c < instrumented_checks.size(); c++) {
+                int i = instrumented_checks[c].code;
+                int code = collective_classes[i].code;
+                basic_block bb = BASIC_BLOCK_FOR_FN(fun, instrumented_checks[c].block);
+                if (bb == NULL) continue;
+                for (gimple_stmt_iterator gsi = gsi_start_bb(bb); !gsi_end_p(gsi); gsi_next(&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        if (is_mpi_call(stmt) == code && class_of_collective(stmt, code) == i
+                            && !instrumented.add(stmt)) instrument_collective(stmt, code);
+                }
+        }
+
+        #ifdef DEBUG
+        printf("[INSTRUMENT] %d collectives checked at run time in %s\n", (int) instrumented.elements(), function_name(fun));
+        #endif
+        return instrumented.elements();
+}
+
+/* Profiling */
+
+/* Site table given by -fplugin-arg-libplugin-profile=<file>, NULL when the collectives are not profiled */
+/* the time stamp counter is read inline around every collective, src/mpicoll_prof.c records the time for its site */
+static FILE *profile_table;
+
+/* Ids already in the site table, a recompiled file does not add its sites again */
+static hash_set<int_hash<uint64_t, 0, 1> > *profile_table_ids;
+
+static tree profile_ticks_decl;
+static tree profile_record_decl;
+
+void mark_profile_decls(void *event_data, void *data)
+{
+        if (profile_ticks_decl != NULL_TREE) ggc_set_mark(profile_ticks_decl);
+        if (profile_record_decl != NULL_TREE) ggc_set_mark(profile_record_decl);
+}
+
+void close_profile_table(void *event_data, void *data)
+{
+        if (profile_table) fclose(profile_table);
+        profile_table = NULL;
+}
+
+/* the site table is appended by every translation unit, one line per site: */
+/* <id> <file> <line> <column> <function> <collective> */
+/* the ids already in the table are read first, their sites are not appended again */
+bool open_profile_table(const char *filename)
+{
+        profile_table = fopen(filename, "a+");
+        if (profile_table == NULL) return false;
+
+        profile_table_ids = new hash_set<int_hash<uint64_t, 0, 1> >;
+        char *line = NULL;
+        size_t size = 0;
+        while (getline(&line, &size, profile_table) != -1) {
+                unsigned long long id;
+                if (sscanf(line, "%llx", &id) == 1 && id > 1) profile_table_ids -> add(id);
+        }
+        free(line);
+        fseek(profile_table, 0, SEEK_END);
+
+        tree ticks = long_long_unsigned_type_node;
+        tree site_ptr = build_pointer_type(long_long_unsigned_type_node);
+        profile_ticks_decl = build_fn_decl("mpicoll_prof_ticks", build_function_type_list(ticks, NULL_TREE));
+        profile_record_decl = build_fn_decl("mpicoll_prof_record",
+                        build_function_type_list(void_type_node, site_ptr, ticks, ticks, NULL_TREE));
+        return true;
+}
+
+/* returns a static array of the sites of the function with their ids, see include/mpicoll_prof.h */
+/* the array goes in the section of the sites, where the runtime finds it without registering it */
+static tree profile_sites_array(const std::vector <uint64_t> &ids)
+{
+        tree site_type = build_array_type_nelts(long_long_unsigned_type_node, MPICOLL_PROF_SITE_WORDS);
+        tree type = build_array_type_nelts(site_type, ids.size());
+        tree sites = build_decl(UNKNOWN_LOCATION, VAR_DECL, create_tmp_var_name("mpicoll_prof_sites"), type);
+        TREE_STATIC(sites) = 1;
+        TREE_PUBLIC(sites) = 0;
+        TREE_USED(sites) = 1;
+        TREE_ADDRESSABLE(sites) = 1;
+        DECL_ARTIFICIAL(sites) = 1;
+        DECL_IGNORED_P(sites) = 1;
+
+        /* no other alignment than the one of the sites, the arrays follow each other in the section */
+        SET_DECL_ALIGN(sites, MPICOLL_PROF_SITE_ALIGN * BITS_PER_UNIT);
+        DECL_USER_ALIGN(sites) = 1;
+        set_decl_section_name(sites, MPICOLL_PROF_SECTION);
+
+        vec<constructor_elt, va_gc> *elts = NULL;
+        for (size_t k = 0; k < ids.size(); k++) {
+                tree id = build_int_cst(long_long_unsigned_type_node, (HOST_WIDE_INT) ids[k]);
+                tree site = build_constructor_single(site_type, size_int(0), id);
+                TREE_CONSTANT(site) = TREE_STATIC(site) = 1;
+                CONSTRUCTOR_APPEND_ELT(elts, size_int(k), site);
+        }
+        tree init = build_constructor(type, elts);
+        TREE_CONSTANT(init) = TREE_STATIC(init) = 1;
+        DECL_INITIAL(sites) = init;
+
+        varpool_node::finalize_decl(sites);
+        return sites;
+}
+
+/* returns a statement reading the ticks in a new value, inline asm where include/mpicoll_prof.h has one */
+/* the asm clobbers the memory so that it stays next to the collective */
+static gimple *profile_ticks(function *fun, tree *value)
+{
+        *value = gimple_in_ssa_p(fun) ? make_temp_ssa_name(long_long_unsigned_type_node, NULL, "mpicoll_ticks")
+                : create_tmp_var(long_long_unsigned_type_node, "mpicoll_ticks");
+        gimple *stmt;
+#ifdef MPICOLL_PROF_TICKS_ASM
+        vec<tree, va_gc> *outputs = NULL;
+        vec<tree, va_gc> *clobbers = NULL;
+        tree constraint = build_string(strlen(MPICOLL_PROF_TICKS_OUTPUT) + 1, MPICOLL_PROF_TICKS_OUTPUT);
+        vec_safe_push(outputs, build_tree_list(build_tree_list(NULL_TREE, constraint), *value));
+        vec_safe_push(clobbers, build_tree_list(NULL_TREE, build_string(strlen(MPICOLL_PROF_TICKS_CLOBBER) + 1, MPICOLL_PROF_TICKS_CLOBBER)));
+        vec_safe_push(clobbers, build_tree_list(NULL_TREE, build_string(strlen("memory") + 1, "memory")));
+        gasm *read = gimple_build_asm_vec(MPICOLL_PROF_TICKS_ASM, NULL, outputs, clobbers, NULL);
+        gimple_asm_set_volatile(read, true);
+        stmt = read;
+#else
+        gcall *read = gimple_build_call(profile_ticks_decl, 0);
+        gimple_call_set_lhs(read, *value);
+        stmt = read;
+#endif
+        if (TREE_CODE(*value) == SSA_NAME) SSA_NAME_DEF_STMT(*value) = stmt;
+        return stmt;
+}
+
+/* surrounds the collectives with the probes, each collective of the function has a slot of a static */
+/* array given to the runtime with the ticks read before and after it. The id of a site is a hash of its */
+/* location and collective, so that the sites of several translation units do not need to be numbered together */
+/* the histograms are written by the MPI_Finalize of the runtime, wherever the program calls it */
+void profile_collectives(function *fun)
+{
+        basic_block bb;
+        gimple_stmt_iterator gsi;
+
+        std::vector <uint64_t> ids;
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        int code = is_mpi_call(stmt);
+                        if (code == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE || code == MPI_INIT || code == MPI_FINALIZE) continue;
+
+                        expanded_location loc = expand_location(gimple_location(stmt));
+                        const char *file = loc.file ? loc.file : "<unknown>";
+                        uint64_t id = 0xcbf29ce484222325ULL;
+                        cache_hash(&id, file, strlen(file));
+                        cache_hash_int(&id, loc.line);
+                        cache_hash_int(&id, loc.column);
+                        cache_hash(&id, mpi_collective_name[code], strlen(mpi_collective_name[code]));
+                        if (id <= 1 || !profile_table_ids -> add(id)) {
+                                fprintf(profile_table, "%016llx %s %d %d %s %s\n", (unsigned long long) id, file, loc.line, loc.column,
+                                                function_name(fun), mpi_collective_name[code]);
+                        }
+                        ids.push_back(id);
+                }
+        }
+        if (ids.empty()) return;
+        tree sites = profile_sites_array(ids);
+        int site = 0;
+
+        FOR_EACH_BB_FN(bb, fun) {
+                for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi); gsi_next (&gsi)) {
+                        gimple *stmt = gsi_stmt(gsi);
+                        int code = is_mpi_call(stmt);
+                        if (code == LAST_AND_UNUSED_MPI_COLLECTIVE_CODE || code == MPI_INIT || code == MPI_FINALIZE) continue;
+
+                        /* &sites[site][0] */
+                        tree slot = build4(ARRAY_REF, TREE_TYPE(TREE_TYPE(sites)), sites, size_int(site++), NULL_TREE, NULL_TREE);
+                        slot = build4(ARRAY_REF, long_long_unsigned_type_node, slot, size_int(0), NULL_TREE, NULL_TREE);
+
+                        tree start, end;
+                        gimple *before = profile_ticks(fun, &start);
+                        gimple_set_location(before, gimple_location(stmt));
+                        gsi_insert_before(&gsi, before, GSI_SAME_STMT);
+
+                        gimple *after = profile_ticks(fun, &end);
+                        gimple_set_location(after, gimple_location(stmt));
+                        gsi_insert_after(&gsi, after, GSI_NEW_STMT);
+
+                        gcall *record = gimple_build_call(profile_record_decl, 3, build_fold_addr_expr(slot), start, end);
+                        gimple_set_location(record, gimple_location(stmt));
+                        gsi_insert_after(&gsi, record, GSI_NEW_STMT);
+                        code_changed = true;
+                }
+        }
+}
+
+/* CFG export */
+
+/* File given by -fplugin-arg-libplugin-export=<file>, NULL when not requested */
+/* it receives the CFG of every checked function for mpicoll-analyze, see include/mpicoll_cfg.h */
+static FILE *export_file;
+
+/* Size of the buffer of the export file */
+#define EXPORT_BUFFER_SIZE (1 << 16)
+
+/* opens the export file and writes its header with the table of collectives */
+static bool open_export_file(const char *filename)
+{
+        export_file = fopen(filename, "wb");
+        if (export_file == NULL) return false;
+        setvbuf(export_file, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+
+        fwrite(MPICOLL_CFG_MAGIC, 1, 4, export_file);
+        mpicoll_cfg_write_uint(export_file, MPICOLL_CFG_VERSION);
+        mpicoll_cfg_write_uint(export_file, LAST_AND_UNUSED_MPI_COLLECTIVE_CODE);
+        for (int i=0; i < LAST_AND_UNUSED_MPI_COLLECTIVE_CODE; i++) mpicoll_cfg_write_string(export_file, mpi_collective_name[i]);
+        return true;
+}
+
+void close_export_file(void *event_data, void *data) {
+        if (export_file) fclose(export_file);
+        export_file = NULL;
+}
+
+/* writes the CFG of the current function with the collectives of each block and the locations of the warnings */
+/* relies on the counts set up by prepare_cfg */
+void export_cfg(function *fun)
+{
+        int nb_blocks = last_basic_block_for_fn(fun);
+
+        mpicoll_cfg_write_string(export_file, function_name(fun));
+        mpicoll_cfg_write_string(export_file, LOCATION_FILE(fun -> function_start_locus));
+        mpicoll_cfg_write_uint(export_file, LOCATION_LINE(fun -> function_start_locus));
+        mpicoll_cfg_write_uint(export_file, nb_collective_classes);
+        for (int i=0; i < nb_collective_classes; i++) mpicoll_cfg_write_uint(export_file, collective_classes[i].code);
+        mpicoll_cfg_write_uint(export_file, nb_blocks);
+
+        for (int k=0; k < nb_blocks; k++) {
+                basic_block bb = BASIC_BLOCK_FOR_FN(fun, k);
+                if (bb == NULL) {
+                        mpicoll_cfg_write_uint(export_file, 0);
+                        continue;
+                }
+                mpicoll_cfg_write_uint(export_file, 1);
+
+                edge e;
+                edge_iterator it;
+                mpicoll_cfg_write_uint(export_file, EDGE_COUNT(bb -> succs));
+                FOR_EACH_EDGE(e, it, bb -> succs) {
+                        mpicoll_cfg_write_uint(export_file, e -> dest -> index);
+                }
+
+                /* each collective is located at the first statement executing it in the block */
+                int *counts = counts_of_block(k);
+                int nb_entries = 0;
+                for (int i=0; i < nb_collective_classes; i++) {
+                        if (counts[i] != 0) nb_entries++;
+                }
+                mpicoll_cfg_write_uint(export_file, nb_entries);
+                for (int i=0; i < nb_collective_classes; i++) {
+                        if (counts[i] == 0) continue;
+                        int code = collective_classes[i].code;
+                        location_t loc = UNKNOWN_LOCATION;
+                        gimple_stmt_iterator gsi;
+                        for (gsi = gsi_start_bb (bb); !gsi_end_p (gsi) && loc == UNKNOWN_LOCATION; gsi_next (&gsi)) {
+                                gimple *stmt = gsi_stmt(gsi);
+                                collective_summary *summary = summary_of_call(stmt);
+                                if ((is_mpi_call(stmt) == code && class_of_collective(stmt, code) == i)
+                                    || (summary != NULL && summary -> counts[code] != 0)) loc = gimple_location(stmt);
+                        }
+                        mpicoll_cfg_write_uint(export_file, i);
+                        mpicoll_cfg_write_uint(export_file, counts[i]);
+                        mpicoll_cfg_write_uint(export_file, LOCATION_LINE(loc));
+                        mpicoll_cfg_write_uint(export_file, LOCATION_COLUMN(loc));
+                }
+
+                gimple_stmt_iterator last = gsi_last_bb(bb);
+                location_t loc = gsi_end_p(last) ? UNKNOWN_LOCATION : gimple_location(gsi_stmt(last));
+                mpicoll_cfg_write_uint(export_file, LOCATION_LINE(loc));
+                mpicoll_cfg_write_uint(export_file, LOCATION_COLUMN(loc));
+                mpicoll_cfg_write_uint(export_file, rank_dependent_forks == NULL || bitmap_bit_p(rank_dependent_forks, bb -> index));
+        }
+}
+
+/* Functions calling a function whose CFG was not built yet when they were examined */
+/* they are analyzed when all the functions of the translation unit are lowered */
+static std::vector<tree> deferred_functions;
+static bool deferred_final_run;         /* the functions are deferred by the run at the placement before the IPA stage */
+
+/* profiles the collectives and releases everything the analysis of the function allocated */
+static unsigned int finish_analysis(function *fun, int nb_collectives)
+{
+        if (cache_store_pending) {
+                phase_start(PHASE_CACHE);
+                cache_store(fun);
+                phase_stop(PHASE_CACHE);
+        }
+        if (profile_table != NULL && final_run) {
+                phase_start(PHASE_PROFILE);
+                profile_collectives(fun);
+                phase_stop(PHASE_PROFILE);
+        }
+        free_dominance_info(CDI_POST_DOMINATORS);
+        if (stats_file) stats_dump(fun, nb_collectives);
+
+        /* the call graph is already built, the removed barriers, the checks and the probes change its edges */
+        unsigned int todo = 0;
+        if (code_changed) {
+                if (symtab -> state >= IPA) cgraph_edge::rebuild_edges();
+                if (gimple_in_ssa_p(fun)) {
+                        mark_virtual_operands_for_renaming(fun);
+                        todo |= TODO_update_ssa_only_virtuals;
+                }
+        }
+        code_changed = false;
+        block_counts = NULL;
+        block_ranks = NULL;
+        nb_collective_classes = 0;
+        rank_dependent_forks = NULL;
+        summarized_loops = NULL;
+        nb_summarized_loops = 0;
+        summarized_nodes.clear();
+        if (summarized_nodes_index != NULL) summarized_nodes_index -> empty();
+        bitmap_obstack_release(&mpicoll_obstack);
+        return todo;
+}
+
+/* analyzes the current function and prints the warnings */
+/* when deferrable is true and a called function has no CFG yet, the function is deferred instead */
+unsigned int analyze_function(function *fun, bool deferrable)
+{
+        bitmap_obstack_initialize(&mpicoll_obstack);
+        memset(phase_time, 0, sizeof(phase_time));
+        printed_warnings.clear();
+        instrumented_checks.clear();
+
+        phase_start(PHASE_CLASSIFY);
+        bool pending = false;
+        int nb_collectives = classify_mpi_calls(fun, &pending);
+        phase_stop(PHASE_CLASSIFY);
+
+        /* a called function has no CFG yet, the analysis waits for the IPA stage */
+        if (pending && deferrable) {
+                #ifdef DEBUG
+                printf("[SUMMARY] %s deferred to the IPA stage\n", function_name(fun));
+                #endif
+                deferred_functions.push_back(fun -> decl);
+                deferred_final_run = final_run;
+                bitmap_obstack_release(&mpicoll_obstack);
+                return 0;
+        }
+
+        if (redundant_barriers != BARRIERS_IGNORED && final_run) {
+                phase_start(PHASE_BARRIERS);
+                nb_collectives -= find_redundant_barriers(fun);
+                phase_stop(PHASE_BARRIERS);
+        }
+
+        /* without collectives no deadlock is possible, the analysis is skipped */
+        if (nb_collectives == 0) {
+                printf("No potential deadlock found.\n");
+                return finish_analysis(fun, nb_collectives);
+        }
+
+        cfgviz_dump(fun, CFGVIZ_INITIAL);
+        prepare_cfg(fun);
+        cfgviz_dump(fun, CFGVIZ_SPLIT);
+        if (overlap_min_statements > 0 && final_run) {
+                phase_start(PHASE_OVERLAP);
+                suggest_overlaps(fun);
+                phase_stop(PHASE_OVERLAP);
+        }
+        if (fusion_enabled && final_run) {
+                phase_start(PHASE_FUSION);
+                find_fusable_reductions(fun);
+                phase_stop(PHASE_FUSION);
+        }
+
+        /* the export gives the forks going the same way on every process, otherwise they are */
+        /* only needed on a cache miss, the key hashes the operands they depend on */
+        bitmap_head *frontiers = NULL;
+        if (export_file != NULL && final_run) {
+                if (!all_forks) frontiers = rank_dependent_frontiers(fun);
+                export_cfg(fun);
+        }
+
+        /* the results of a function whose CFG did not change are replayed from the cache */
+        /* with the checks inserted by the instrumentation */
+        if (cache_directory != NULL) {
+                phase_start(PHASE_CACHE);
+                bool hit = cache_lookup(fun);
+                phase_stop(PHASE_CACHE);
+                if (hit) {
+                        if (instrument_enabled && final_run && !instrumented_checks.empty()) {
+                                phase_start(PHASE_INSTRUMENT);
+                                instrument_checks(fun);
+                                phase_stop(PHASE_INSTRUMENT);
+                        }
+                        return finish_analysis(fun, nb_collectives);
+                }
+        }
+
+        phase_start(PHASE_PDF);
+        calculate_dominance_info(CDI_POST_DOMINATORS);
+        phase_stop(PHASE_PDF);
+
+        phase_start(PHASE_CFG_PRIME);
+        bitmap_head *invalid_edges = cfg_prime(fun);
+        phase_stop(PHASE_CFG_PRIME);
+        cfgviz_dump(fun, CFGVIZ_INVALID_EDGES, invalid_edges);
+
+        /* every collective is executed once on every path, the analysis is skipped */
+        /* a collective in a loop is behind an invalid edge, so no loop needs a summary here */
+        if (collectives_on_every_path(fun, invalid_edges)) {
+                printf("No potential deadlock found.\n");
+                return finish_analysis(fun, nb_collectives);
+        }
+
+        if (!all_forks && frontiers == NULL) frontiers = rank_dependent_frontiers(fun);
+        if (frontiers == NULL) {
+                phase_start(PHASE_PDF);
+                frontiers = post_dominance_frontiers(fun);
+                phase_stop(PHASE_PDF);
+        }
+
+        /* the loops are summarized once the forks depending on the process are known */
+        if (rank_dependent_forks != NULL) {
+                phase_start(PHASE_LOOPS);
+                nb_summarized_loops = summarize_loops(fun);
+                phase_stop(PHASE_LOOPS);
+        }
+
+        phase_start(PHASE_RANK);
+        calculate_rank(fun, invalid_edges);
+        phase_stop(PHASE_RANK);
+
+        phase_start(PHASE_SETS);
+        bitmap_head **sets = collective_rank_set(fun);
+        phase_stop(PHASE_SETS);
+
+        phase_start(PHASE_SET_POST_DOMINANCE);
+        bitmap_head **set_postdominated = set_post_dominance(fun, sets);
+        phase_stop(PHASE_SET_POST_DOMINANCE);
+
+        phase_start(PHASE_SET_FRONTIERS);
+        bitmap_head **set_frontiers = set_post_dominance_frontiers(fun, set_postdominated, frontiers);
+        phase_stop(PHASE_SET_FRONTIERS);
+
+        phase_start(PHASE_IPDF);
+        bitmap_head **it_frontier = iterated_post_dominance_frontiers(fun, set_frontiers, frontiers);
+        phase_stop(PHASE_IPDF);
+
+        if (rank_dependent_forks != NULL) {
+                phase_start(PHASE_TAINT);
+                prune_uniform_forks(fun, it_frontier);
+                phase_stop(PHASE_TAINT);
+        }
+
+        phase_start(PHASE_WARNINGS);
+        bool warnings = print_warnings(fun, it_frontier, sets);
+        phase_stop(PHASE_WARNINGS);
+        if (!warnings) printf("No potential deadlock found.\n");
+
+        if (instrument_enabled && warnings && final_run) {
+                phase_start(PHASE_INSTRUMENT);
+                instrument_collectives(fun, it_frontier, sets);
+                phase_stop(PHASE_INSTRUMENT);
+        }
+
+        return finish_analysis(fun, nb_collectives);
+}
+
+/* IPA stage: every function now has a CFG, the deferred functions are analyzed with the summaries of all their callees */
+void analyze_deferred_functions(void *event_data, void *data)
+{
+        for (size_t k = 0; k < deferred_functions.size(); k++) {
+                function *fn = DECL_STRUCT_FUNCTION(deferred_functions[k]);
+                if (fn == NULL || fn -> cfg == NULL) continue;
+                push_cfun(fn);
+                final_run = deferred_final_run;
+                unsigned int todo = analyze_function(fn, false);
+                if (todo & TODO_update_ssa_only_virtuals) update_ssa(TODO_update_ssa_only_virtuals);
+                pop_cfun();
+        }
+        deferred_functions.clear();
+}
+
 /* Global object (const) to represent my pass */
 const pass_data mpicoll_pass_data =
 {
         GIMPLE_PASS, /* type */
         "mpicoll", /* name */
         OPTGROUP_NONE, /* optinfo_flags */
-        TV_OPTIMIZE, /* tv_id */
+        TV_PLUGIN_RUN, /* tv_id */
         0, /* properties_required */
         0, /* properties_provided */
         0, /* properties_destroyed */
@@ -817,21 +3453,22 @@ const pass_data mpicoll_pass_data =
 class mpicoll_pass : public gimple_opt_pass
 {       
         public: 
-                mpicoll_pass (gcc::context *ctxt)
-                        : gimple_opt_pass (mpicoll_pass_data, ctxt)
+                mpicoll_pass (gcc::context *ctxt, unsigned placement)
+                        : gimple_opt_pass (mpicoll_pass_data, ctxt), placement(placement)
                 {}
                 
                 
                 mpicoll_pass *clone ()
                 {       
-                        return new mpicoll_pass(g);
+                        return new mpicoll_pass(g, placement);
                 }
 		               
                 bool gate (function *fun)
                 {       
-			const char* fname = fndecl_name(cfun->decl);
-    			if (remove_function_from_pragma_list(fname)) {
-        			printf("Now starting to examine function %s\n", fname);
+			const char* fname = fndecl_name(fun->decl);
+    			if (is_function_checked(fun->decl)) {
+				if (placements.size() > 1) printf("Now starting to examine function %s after %s\n", fname, placements[placement].pass);
+        			else printf("Now starting to examine function %s\n", fname);
         			return true;
     			}
     			return false;
@@ -839,27 +3476,33 @@ class mpicoll_pass : public gimple_opt_pass
                 
                 unsigned int execute (function *fun)
                 {       
-			cfgviz_dump(fun, "initial");
-                        prepare_cfg(fun);
-                        cfgviz_dump(fun, "split");
-                        calculate_dominance_info(CDI_POST_DOMINATORS);
-                        bitmap_head *frontiers = post_dominance_frontiers(fun);
-                        bitmap_head *invalid_edges = cfg_prime(fun);
-			cfgviz_dump(fun, "invalid_edges", invalid_edges);
-                        calculate_rank(fun, invalid_edges);
-                        bitmap_head **sets = collective_rank_set(fun);
-                        bitmap_head **set_postdominated = set_post_dominance(fun, sets);
-                        bitmap_head **set_frontiers = set_post_dominance_frontiers(fun, set_postdominated, frontiers);
-                        bitmap_head **it_frontier = iterated_post_dominance_frontiers(fun, set_frontiers, frontiers);
-                        bool warnings = print_warnings(fun, it_frontier, sets);
-			if (!warnings) printf("No potential deadlock found.\n");
-                        clean_aux_field(fun, 0);
-
-                        free_dominance_info(CDI_POST_DOMINATORS);
-                        return 0;
+                        final_run = placement == placements.size() - 1;
+                        return analyze_function(fun, true);
                 }
+
+        private:
+                unsigned placement;     /* index in placements */
 };
 
+/* parses <pass>[:<instance>], early stands for the pass running the early optimizations: */
+/* the wrappers are inlined, the dead branches removed and the CFG cleaned up */
+static bool add_placement(const char *value)
+{
+        mpicoll_placement placement;
+        char *pass = xstrdup(value);
+        char *colon = strchr(pass, ':');
+        placement.instance = 0;
+        if (colon != NULL) {
+                *colon = '\0';
+                placement.instance = atoi(colon + 1);
+                if (placement.instance <= 0) return false;
+        }
+        if (*pass == '\0') return false;
+        placement.pass = strcmp(pass, "early") == 0 ? "early_optimizations" : pass;
+        placements.push_back(placement);
+        return true;
+}
+
         int
 plugin_init(struct plugin_name_args * plugin_info,
                 struct plugin_gcc_version * version)
@@ -875,23 +3518,129 @@ plugin_init(struct plugin_name_args * plugin_info,
 
         printf( "plugin_init: Check ok...\n" ) ;
 
-        /* Declare and build my new pass */
-        mpicoll_pass p(g);
+        /* Plugin arguments given with -fplugin-arg-<name>-<key>[=<value>] */
+        for (int i = 0; i < plugin_info->argc; i++) {
+                const char *key = plugin_info->argv[i].key;
+                const char *value = plugin_info->argv[i].value;
 
-        /* Fill info on my pass 
- *          (insertion after the pass building the CFG) */
-        mpicoll_pass_info.pass = &p;
-        mpicoll_pass_info.reference_pass_name = "cfg";
-        mpicoll_pass_info.ref_pass_instance_number = 0;
-        mpicoll_pass_info.pos_op = PASS_POS_INSERT_AFTER;
-	
-        /* Add my pass to the pass manager */
-        register_callback(plugin_info->base_name,
-                        PLUGIN_PASS_MANAGER_SETUP,
-                        NULL,
-                        &mpicoll_pass_info);
+                if (strcmp(key, "stats") == 0) {
+                        if (value == NULL) {
+                                error("%<-fplugin-arg-%s-stats%> expects a file name", plugin_info->base_name);
+                                return 1;
+                        }
+                        stats_file = fopen(value, "a");
+                        if (stats_file == NULL) {
+                                error("cannot open statistics file %s: %m", value);
+                                return 1;
+                        }
+                        register_callback(plugin_info->base_name, PLUGIN_FINISH, close_stats_file, NULL);
+                }
+                else if (strcmp(key, "overlap") == 0) {
+                        overlap_min_statements = value ? atoi(value) : OVERLAP_DEFAULT_MIN_STATEMENTS;
+                        if (overlap_min_statements <= 0) {
+                                error("%<-fplugin-arg-%s-overlap%> expects a positive number of statements", plugin_info->base_name);
+                                return 1;
+                        }
+                }
+                else if (strcmp(key, "fusion") == 0) {
+                        fusion_enabled = true;
+                }
+                else if (strcmp(key, "pass") == 0) {
+                        if (value == NULL || !add_placement(value)) {
+                                error("%<-fplugin-arg-%s-pass%> expects a pass name and an optional instance, <pass>[:<instance>]", plugin_info->base_name);
+                                return 1;
+                        }
+                }
+                else if (strcmp(key, "all-forks") == 0) {
+                        all_forks = true;
+                }
+                else if (strcmp(key, "redundant-barriers") == 0) {
+                        if (value == NULL) redundant_barriers = BARRIERS_REPORTED;
+                        else if (strcmp(value, "remove") == 0) redundant_barriers = BARRIERS_REMOVED;
+                        else {
+                                error("%<-fplugin-arg-%s-redundant-barriers%> expects nothing or remove", plugin_info->base_name);
+                                return 1;
+                        }
+                }
+                else if (strcmp(key, "instrument") == 0) {
+                        instrument_enabled = true;
+                        register_callback(plugin_info->base_name, PLUGIN_GGC_MARKING, mark_instrument_decls, NULL);
+                }
+                else if (strcmp(key, "profile") == 0 && value != NULL) {
+                        if (!open_profile_table(value)) {
+                                error("cannot open profile site table %s: %m", value);
+                                return 1;
+                        }
+                        register_callback(plugin_info->base_name, PLUGIN_FINISH, close_profile_table, NULL);
+                        register_callback(plugin_info->base_name, PLUGIN_GGC_MARKING, mark_profile_decls, NULL);
+                }
+                else if (strcmp(key, "export") == 0 && value != NULL) {
+                        if (!open_export_file(value)) {
+                                error("cannot open export file %s: %m", value);
+                                return 1;
+                        }
+                        register_callback(plugin_info->base_name, PLUGIN_FINISH, close_export_file, NULL);
+                }
+                else if (strcmp(key, "cache-dir") == 0 && value != NULL) {
+                        cache_directory = value;
+                        if (mkdir(value, 0777) != 0 && errno != EEXIST) {
+                                error("cannot create cache directory %s: %m", value);
+                                return 1;
+                        }
+                }
+                else if (strcmp(key, "summary-out") == 0 && value != NULL) {
+                        summary_out_file = value;
+                }
+                else if (strcmp(key, "summary-in") == 0 && value != NULL) {
+                        if (!read_summary_file(value)) {
+                                error("cannot read summary file %s: %m", value);
+                                return 1;
+                        }
+                }
+                else if (strcmp(key, "graph") == 0) {
+                        if (!cfgviz_select_stages(value ? value : "all")) {
+                                error("%<-fplugin-arg-%s-graph%> expects a list of stages among initial, split, invalid_edges and all", plugin_info->base_name);
+                                return 1;
+                        }
+                }
+                else if (strcmp(key, "graph-dir") == 0 && value != NULL) {
+                        cfgviz_directory = xstrdup(value);
+                }
+                else if (strcmp(key, "graph-format") == 0) {
+                        if (value == NULL || (strcmp(value, "dot") != 0 && strcmp(value, "json") != 0)) {
+                                error("%<-fplugin-arg-%s-graph-format%> expects dot or json", plugin_info->base_name);
+                                return 1;
+                        }
+                        cfgviz_json = strcmp(value, "json") == 0;
+                }
+                else {
+                        warning(0, "plugin %s: unknown argument %<%s%>", plugin_info->base_name, key);
+                }
+        }
+
+        /* by default the pass is inserted after the pass building the CFG */
+        if (placements.empty()) add_placement("cfg");
+
+        /* Declare and build my new pass, one instance per placement, the pass manager keeps them */
+        for (unsigned i = 0; i < placements.size(); i++) {
+                mpicoll_pass_info.pass = new mpicoll_pass(g, i);
+                mpicoll_pass_info.reference_pass_name = placements[i].pass;
+                mpicoll_pass_info.ref_pass_instance_number = placements[i].instance;
+                mpicoll_pass_info.pos_op = PASS_POS_INSERT_AFTER;
+
+                /* Add my pass to the pass manager */
+                register_callback(plugin_info->base_name,
+                                PLUGIN_PASS_MANAGER_SETUP,
+                                NULL,
+                                &mpicoll_pass_info);
+        }
 	
 	c_register_pragma("Projet_CA", "mpicoll_check", handle_pragma_fx);
+	c_register_pragma("Projet_CA", "mpicoll_check_match", handle_pragma_match);
+	register_callback(plugin_info->base_name, PLUGIN_ATTRIBUTES, register_attributes, NULL);
+	register_callback(plugin_info->base_name, PLUGIN_GGC_MARKING, mark_pragma_functions, NULL);
+	register_callback(plugin_info->base_name, PLUGIN_ALL_IPA_PASSES_START, analyze_deferred_functions, NULL);
+	if (summary_out_file) register_callback(plugin_info->base_name, PLUGIN_ALL_IPA_PASSES_START, write_summary_file, NULL);
 	register_callback(plugin_info->base_name, PLUGIN_FINISH, not_declared_functions, NULL);
 
         printf( "plugin_init: Pass added...\n" ) ;
@@ -0,0 +1,658 @@
+/* mpicoll-analyze: runs the analysis of the plugin on the CFGs exported with -fplugin-arg-libplugin-export=<file> */
+/* the functions of all the files are analyzed in parallel by a work stealing thread pool */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "../include/mpicoll_cfg.h"
+
+#define ENTRY_BLOCK 0
+#define EXIT_BLOCK 1
+
+/* Set of small integers (blocks or rank sets) */
+struct bitset {
+        std::vector<unsigned long> words;
+
+        void resize(int n) { words.assign((n + 63) / 64, 0); }
+        bool test(int k) const { return (words[k / 64] >> (k % 64)) & 1; }
+        void reset(int k) { words[k / 64] &= ~(1UL << (k % 64)); }
+        bool set(int k) {
+                unsigned long bit = 1UL << (k % 64);
+                bool changed = !(words[k / 64] & bit);
+                words[k / 64] |= bit;
+                return changed;
+        }
+        bool empty() const {
+                for (size_t w = 0; w < words.size(); w++) if (words[w]) return false;
+                return true;
+        }
+        /* this |= a & ~b, returns true if this changed */
+        bool ior_and_compl(const bitset &a, const bitset &b) {
+                bool changed = false;
+                for (size_t w = 0; w < words.size(); w++) {
+                        unsigned long next = words[w] | (a.words[w] & ~b.words[w]);
+                        if (next != words[w]) changed = true;
+                        words[w] = next;
+                }
+                return changed;
+        }
+};
+
+/* Collectives of a block with the location of the first statement executing them */
+struct block_collective {
+        int code;               /* class of the collectives */
+        int count;
+        int line;
+        int column;
+};
+
+struct block_info {
+        bool present;
+        std::vector<int> succs;
+        std::vector<int> preds;
+        std::vector<block_collective> collectives;
+        int last_line;
+        int last_column;
+        bool rank_dependent;    /* the fork ending the block may go different ways on different processes */
+};
+
+/* A function read from an export file */
+struct function_cfg {
+        std::string name;
+        std::string file;
+        int line;
+        const std::vector<std::string> *collective_names;
+        std::vector<int> class_code;            /* code of the collectives of each class */
+        std::vector<block_info> blocks;
+};
+
+/* Table of collectives of each export file, the codes of a function refer to the table of its file */
+static std::deque<std::vector<std::string> > collective_tables;
+static std::vector<function_cfg> functions;
+
+/* Parsing */
+
+static bool read_string(const unsigned char **pos, const unsigned char *end, std::string *str)
+{
+        unsigned long len;
+        if (!mpicoll_cfg_read_uint(pos, end, &len) || (unsigned long) (end - *pos) < len) return false;
+        str -> assign((const char *) *pos, len);
+        *pos += len;
+        return true;
+}
+
+static bool read_int(const unsigned char **pos, const unsigned char *end, int *value)
+{
+        unsigned long v;
+        if (!mpicoll_cfg_read_uint(pos, end, &v)) return false;
+        *value = (int) v;
+        return true;
+}
+
+/* reads a function record, returns false if it is truncated or inconsistent */
+static bool read_function(const unsigned char **pos, const unsigned char *end, function_cfg *fun)
+{
+        int nb_blocks, nb_classes;
+        int nb_codes = fun -> collective_names -> size();
+
+        if (!read_string(pos, end, &fun -> name) || !read_string(pos, end, &fun -> file)
+            || !read_int(pos, end, &fun -> line) || !read_int(pos, end, &nb_classes) || nb_classes < 0
+            || (size_t) nb_classes > (size_t) (end - *pos)) return false;
+        fun -> class_code.resize(nb_classes);
+        for (int i=0; i < nb_classes; i++) {
+                if (!read_int(pos, end, &fun -> class_code[i]) || fun -> class_code[i] < 0 || fun -> class_code[i] >= nb_codes) return false;
+        }
+        if (!read_int(pos, end, &nb_blocks) || nb_blocks < 2 || (size_t) nb_blocks > (size_t) (end - *pos)) return false;
+
+        fun -> blocks.resize(nb_blocks);
+        for (int k=0; k < nb_blocks; k++) {
+                block_info &bb = fun -> blocks[k];
+                int present, nb_succs, nb_entries;
+                if (!read_int(pos, end, &present)) return false;
+                bb.present = present != 0;
+                if (!bb.present) continue;
+
+                if (!read_int(pos, end, &nb_succs)) return false;
+                for (int e=0; e < nb_succs; e++) {
+                        int dest;
+                        if (!read_int(pos, end, &dest) || dest < 0 || dest >= nb_blocks) return false;
+                        bb.succs.push_back(dest);
+                }
+                if (!read_int(pos, end, &nb_entries)) return false;
+                for (int e=0; e < nb_entries; e++) {
+                        block_collective c;
+                        if (!read_int(pos, end, &c.code) || !read_int(pos, end, &c.count)
+                            || !read_int(pos, end, &c.line) || !read_int(pos, end, &c.column) || c.code < 0 || c.code >= nb_classes) return false;
+                        bb.collectives.push_back(c);
+                }
+                int rank_dependent;
+                if (!read_int(pos, end, &bb.last_line) || !read_int(pos, end, &bb.last_column)
+                    || !read_int(pos, end, &rank_dependent)) return false;
+                bb.rank_dependent = rank_dependent != 0;
+        }
+        for (int k=0; k < nb_blocks; k++) {
+                for (size_t e=0; e < fun -> blocks[k].succs.size(); e++) {
+                        int dest = fun -> blocks[k].succs[e];
+                        if (!fun -> blocks[dest].present) return false;
+                        fun -> blocks[dest].preds.push_back(k);
+                }
+        }
+        return fun -> blocks[ENTRY_BLOCK].present && fun -> blocks[EXIT_BLOCK].present && fun -> blocks[ENTRY_BLOCK].succs.size() == 1;
+}
+
+/* reads an export file and appends its functions */
+static bool read_export_file(const char *filename)
+{
+        FILE *in = fopen(filename, "rb");
+        if (in == NULL) {
+                fprintf(stderr, "mpicoll-analyze: cannot open %s\n", filename);
+                return false;
+        }
+        std::vector<unsigned char> data;
+        unsigned char buffer[1 << 16];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + n);
+        fclose(in);
+
+        const unsigned char *pos = data.data();
+        const unsigned char *end = pos + data.size();
+        int version, nb_codes;
+
+        if (data.size() < 4 || memcmp(pos, MPICOLL_CFG_MAGIC, 4) != 0) {
+                fprintf(stderr, "mpicoll-analyze: %s is not an exported CFG file\n", filename);
+                return false;
+        }
+        pos += 4;
+        if (!read_int(&pos, end, &version) || version != MPICOLL_CFG_VERSION || !read_int(&pos, end, &nb_codes)) {
+                fprintf(stderr, "mpicoll-analyze: %s has an unsupported version\n", filename);
+                return false;
+        }
+
+        collective_tables.push_back(std::vector<std::string>(nb_codes));
+        std::vector<std::string> &names = collective_tables.back();
+        for (int i=0; i < nb_codes; i++) {
+                if (!read_string(&pos, end, &names[i])) {
+                        fprintf(stderr, "mpicoll-analyze: %s is truncated\n", filename);
+                        return false;
+                }
+        }
+
+        while (pos < end) {
+                function_cfg fun;
+                fun.collective_names = &names;
+                if (!read_function(&pos, end, &fun)) {
+                        fprintf(stderr, "mpicoll-analyze: %s is truncated or corrupted\n", filename);
+                        return false;
+                }
+                functions.push_back(fun);
+        }
+        return true;
+}
+
+/* Analysis, the same steps as the plugin on the exported CFG */
+
+struct analysis {
+        const function_cfg *fun;
+        int nb_blocks;
+        int nb_codes;                           /* number of classes of collectives */
+        std::vector<int> ipdom;                 /* immediate post-dominator, -1 for the exit */
+        std::vector<std::vector<bool> > invalid_edges;
+        std::vector<int> counts;                /* one row of nb_codes per block */
+        std::vector<int> ranks;                 /* same layout */
+        std::string report;
+
+        int *ranks_of_block(int k) { return &ranks[k * nb_codes]; }
+        int *counts_of_block(int k) { return &counts[k * nb_codes]; }
+};
+
+/* appends to post_order the blocks reached from start in the reverse CFG */
+static void reverse_dfs(const std::vector<std::vector<int> > &preds, int start, std::vector<bool> &visited, std::vector<int> &post_order)
+{
+        if (visited[start]) return;
+        std::vector<std::pair<int, size_t> > to_visit;
+        visited[start] = true;
+        to_visit.push_back(std::make_pair(start, (size_t) 0));
+        while (to_visit.size() != 0) {
+                int bb = to_visit.back().first;
+                size_t e = to_visit.back().second;
+                if (e == preds[bb].size()) {
+                        post_order.push_back(bb);
+                        to_visit.pop_back();
+                        continue;
+                }
+                to_visit.back().second++;
+                int p = preds[bb][e];
+                if (!visited[p]) {
+                        visited[p] = true;
+                        to_visit.push_back(std::make_pair(p, (size_t) 0));
+                }
+        }
+}
+
+/* post-dominators by the iterative algorithm of Cooper, Harvey and Kennedy on the reverse CFG */
+/* blocks that cannot reach the exit are connected to it through a dead end, as GCC does */
+static void post_dominators(analysis *a)
+{
+        const std::vector<block_info> &blocks = a -> fun -> blocks;
+        std::vector<std::vector<int> > succs(a -> nb_blocks), preds(a -> nb_blocks);
+        for (int k=0; k < a -> nb_blocks; k++) {
+                succs[k] = blocks[k].succs;
+                preds[k] = blocks[k].preds;
+        }
+
+        std::vector<int> post_order;
+        std::vector<bool> visited(a -> nb_blocks, false);
+        visited[EXIT_BLOCK] = true;
+        for (size_t e=0; e < preds[EXIT_BLOCK].size(); e++) reverse_dfs(preds, preds[EXIT_BLOCK][e], visited, post_order);
+
+        for (int start=0; start < a -> nb_blocks; start++) {
+                if (!blocks[start].present || visited[start]) continue;
+                /* follow the successors not reached yet until a dead end, and give it a fake edge to the exit */
+                std::vector<bool> seen(a -> nb_blocks, false);
+                int deadend = start;
+                seen[deadend] = true;
+                for (bool moved = true; moved; ) {
+                        moved = false;
+                        for (size_t e=0; e < succs[deadend].size() && !moved; e++) {
+                                int s = succs[deadend][e];
+                                if (!visited[s] && !seen[s]) {
+                                        deadend = s;
+                                        seen[s] = moved = true;
+                                }
+                        }
+                }
+                succs[deadend].push_back(EXIT_BLOCK);
+                reverse_dfs(preds, deadend, visited, post_order);
+        }
+        post_order.push_back(EXIT_BLOCK);
+
+        std::vector<int> number(a -> nb_blocks, -1);
+        for (size_t k=0; k < post_order.size(); k++) number[post_order[k]] = k;
+
+        std::vector<int> &ipdom = a -> ipdom;
+        ipdom.assign(a -> nb_blocks, -1);
+        ipdom[EXIT_BLOCK] = EXIT_BLOCK;
+
+        bool changed = true;
+        while (changed) {
+                changed = false;
+                for (int n = post_order.size() - 2; n >= 0; n--) {
+                        int bb = post_order[n];
+                        int new_ipdom = -1;
+                        for (size_t e=0; e < succs[bb].size(); e++) {
+                                int s = succs[bb][e];
+                                if (ipdom[s] < 0) continue;
+                                if (new_ipdom < 0) {
+                                        new_ipdom = s;
+                                        continue;
+                                }
+                                int f1 = s, f2 = new_ipdom;
+                                while (f1 != f2) {
+                                        while (number[f1] < number[f2]) f1 = ipdom[f1];
+                                        while (number[f2] < number[f1]) f2 = ipdom[f2];
+                                }
+                                new_ipdom = f1;
+                        }
+                        if (new_ipdom >= 0 && ipdom[bb] != new_ipdom) {
+                                ipdom[bb] = new_ipdom;
+                                changed = true;
+                        }
+                }
+        }
+        ipdom[EXIT_BLOCK] = -1;
+}
+
+/* returns true if block a is post-dominated by block b */
+static bool post_dominated_by(analysis *an, int a, int b)
+{
+        for (int p = a; p >= 0; p = an -> ipdom[p]) {
+                if (p == b) return true;
+        }
+        return false;
+}
+
+/* marks the edges going to a block that is still on the depth first search path */
+static void cfg_prime(analysis *a)
+{
+        const std::vector<block_info> &blocks = a -> fun -> blocks;
+        a -> invalid_edges.resize(a -> nb_blocks);
+        for (int k=0; k < a -> nb_blocks; k++) a -> invalid_edges[k].assign(blocks[k].succs.size(), false);
+
+        std::vector<bool> visited(a -> nb_blocks, false), on_path(a -> nb_blocks, false);
+        std::vector<std::pair<int, size_t> > to_visit;
+        visited[ENTRY_BLOCK] = on_path[ENTRY_BLOCK] = true;
+        to_visit.push_back(std::make_pair(ENTRY_BLOCK, (size_t) 0));
+
+        while (to_visit.size() != 0) {
+                int bb = to_visit.back().first;
+                size_t e = to_visit.back().second;
+                if (e == blocks[bb].succs.size()) {
+                        on_path[bb] = false;
+                        to_visit.pop_back();
+                        continue;
+                }
+                to_visit.back().second++;
+                int child = blocks[bb].succs[e];
+                if (on_path[child]) a -> invalid_edges[bb][e] = true;
+                else if (!visited[child]) {
+                        visited[child] = on_path[child] = true;
+                        to_visit.push_back(std::make_pair(child, (size_t) 0));
+                }
+        }
+}
+
+static bool collectives_on_every_path(analysis *a)
+{
+        const std::vector<block_info> &blocks = a -> fun -> blocks;
+        int first = blocks[ENTRY_BLOCK].succs[0];
+        for (int k=0; k < a -> nb_blocks; k++) {
+                for (size_t e=0; e < a -> invalid_edges[k].size(); e++) if (a -> invalid_edges[k][e]) return false;
+        }
+        for (int k=0; k < a -> nb_blocks; k++) {
+                if (blocks[k].present && blocks[k].collectives.size() != 0 && !post_dominated_by(a, first, k)) return false;
+        }
+        return true;
+}
+
+/* ranks of each collective at the end of each block, in reverse post-order of the CFG without its invalid edges */
+static void calculate_rank(analysis *a)
+{
+        const std::vector<block_info> &blocks = a -> fun -> blocks;
+        std::vector<int> post_order;
+        std::vector<bool> visited(a -> nb_blocks, false);
+        std::vector<std::pair<int, size_t> > to_visit;
+        visited[ENTRY_BLOCK] = true;
+        to_visit.push_back(std::make_pair(ENTRY_BLOCK, (size_t) 0));
+        while (to_visit.size() != 0) {
+                int bb = to_visit.back().first;
+                size_t e = to_visit.back().second;
+                if (e == blocks[bb].succs.size()) {
+                        post_order.push_back(bb);
+                        to_visit.pop_back();
+                        continue;
+                }
+                to_visit.back().second++;
+                if (a -> invalid_edges[bb][e]) continue;
+                int child = blocks[bb].succs[e];
+                if (!visited[child]) {
+                        visited[child] = true;
+                        to_visit.push_back(std::make_pair(child, (size_t) 0));
+                }
+        }
+
+        int *last_ranks = a -> ranks_of_block(EXIT_BLOCK);
+        for (int n = post_order.size() - 1; n >= 0; n--) {
+                int bb = post_order[n];
+                int *father_ranks = a -> ranks_of_block(bb);
+                for (size_t e=0; e < blocks[bb].succs.size(); e++) {
+                        int child = blocks[bb].succs[e];
+                        int *child_ranks = a -> ranks_of_block(child);
+                        int *child_counts = a -> counts_of_block(child);
+                        for (int i=0; i < a -> nb_codes; i++) {
+                                if (!a -> invalid_edges[bb][e]) {
+                                        if (father_ranks[i] + child_counts[i] > child_ranks[i]) child_ranks[i] = father_ranks[i] + child_counts[i];
+                                }
+                                else if (father_ranks[i] > last_ranks[i]) last_ranks[i] = father_ranks[i];
+                        }
+                }
+        }
+}
+
+/* finds the location of the first statement executing a collective in a block */
+static const block_collective *collective_in_block(const block_info &bb, int code)
+{
+        for (size_t e=0; e < bb.collectives.size(); e++) {
+                if (bb.collectives[e].code == code) return &bb.collectives[e];
+        }
+        return NULL;
+}
+
+static void analyze(analysis *a)
+{
+        const function_cfg *fun = a -> fun;
+        const std::vector<block_info> &blocks = fun -> blocks;
+        char line[1024];
+
+        a -> nb_blocks = blocks.size();
+        a -> nb_codes = fun -> class_code.size();
+        a -> counts.assign(a -> nb_blocks * a -> nb_codes, 0);
+        a -> ranks.assign(a -> nb_blocks * a -> nb_codes, 0);
+
+        int nb_collectives = 0;
+        for (int k=0; k < a -> nb_blocks; k++) {
+                for (size_t e=0; e < blocks[k].collectives.size(); e++) {
+                        a -> counts_of_block(k)[blocks[k].collectives[e].code] += blocks[k].collectives[e].count;
+                        nb_collectives += blocks[k].collectives[e].count;
+                }
+        }
+        if (nb_collectives == 0) return;
+
+        post_dominators(a);
+        cfg_prime(a);
+        if (collectives_on_every_path(a)) return;
+
+        /* post dominance frontiers of the blocks */
+        std::vector<bitset> frontiers(a -> nb_blocks);
+        for (int k=0; k < a -> nb_blocks; k++) frontiers[k].resize(a -> nb_blocks);
+        for (int k=0; k < a -> nb_blocks; k++) {
+                if (!blocks[k].present || blocks[k].succs.size() < 2) continue;
+                for (size_t e=0; e < blocks[k].succs.size(); e++) {
+                        for (int p = blocks[k].succs[e]; p >= 0 && p != a -> ipdom[k]; p = a -> ipdom[p]) frontiers[p].set(k);
+                }
+        }
+
+        calculate_rank(a);
+        int *max_ranks = a -> ranks_of_block(EXIT_BLOCK);
+
+        /* rank sets, numbered in order of collective code and rank */
+        std::vector<int> set_code, set_rank;
+        std::vector<int> first_set(a -> nb_codes);
+        for (int i=0; i < a -> nb_codes; i++) {
+                first_set[i] = set_code.size();
+                for (int j=0; j < max_ranks[i]; j++) {
+                        set_code.push_back(i);
+                        set_rank.push_back(j);
+                }
+        }
+        int nb_sets = set_code.size();
+
+        std::vector<bitset> sets(nb_sets), in_sets(a -> nb_blocks), avoided(a -> nb_blocks);
+        for (int s=0; s < nb_sets; s++) sets[s].resize(a -> nb_blocks);
+        for (int k=0; k < a -> nb_blocks; k++) {
+                in_sets[k].resize(nb_sets);
+                avoided[k].resize(nb_sets);
+                if (k == ENTRY_BLOCK || k == EXIT_BLOCK || !blocks[k].present) continue;
+                int *counts = a -> counts_of_block(k);
+                int *ranks = a -> ranks_of_block(k);
+                for (int i=0; i < a -> nb_codes; i++) {
+                        for (int n=0; n < counts[i]; n++) {
+                                int s = first_set[i] + ranks[i] - 1 - n;
+                                sets[s].set(k);
+                                in_sets[k].set(s);
+                        }
+                }
+        }
+
+        /* sets that each block can avoid on one of its paths to the exit, the others post-dominate it */
+        bitset all_sets;
+        all_sets.resize(nb_sets);
+        for (int s=0; s < nb_sets; s++) all_sets.set(s);
+        bitset none;
+        none.resize(nb_sets);
+        avoided[EXIT_BLOCK].ior_and_compl(all_sets, none);
+
+        std::vector<bool> queued(a -> nb_blocks, false);
+        std::vector<int> to_visit;
+        to_visit.push_back(EXIT_BLOCK);
+        queued[EXIT_BLOCK] = true;
+        while (to_visit.size() != 0) {
+                int bb = to_visit.back();
+                to_visit.pop_back();
+                queued[bb] = false;
+                for (size_t e=0; e < blocks[bb].preds.size(); e++) {
+                        int parent = blocks[bb].preds[e];
+                        if (parent == ENTRY_BLOCK) continue;
+                        if (avoided[parent].ior_and_compl(avoided[bb], in_sets[parent]) && !queued[parent]) {
+                                queued[parent] = true;
+                                to_visit.push_back(parent);
+                        }
+                }
+        }
+
+        std::vector<bitset> post_dominated(nb_sets), set_frontiers(nb_sets), iterated(nb_sets);
+        for (int s=0; s < nb_sets; s++) {
+                post_dominated[s].resize(a -> nb_blocks);
+                set_frontiers[s].resize(a -> nb_blocks);
+                iterated[s].resize(a -> nb_blocks);
+        }
+        for (int k=1; k < a -> nb_blocks; k++) {
+                if (!blocks[k].present) continue;
+                for (int s=0; s < nb_sets; s++) if (!avoided[k].test(s)) post_dominated[s].set(k);
+        }
+
+        for (int s=0; s < nb_sets; s++) {
+                for (int k=0; k < a -> nb_blocks; k++) {
+                        if (post_dominated[s].test(k)) set_frontiers[s].ior_and_compl(frontiers[k], post_dominated[s]);
+                }
+                iterated[s].ior_and_compl(set_frontiers[s], none);
+                std::vector<int> work;
+                for (int k=0; k < a -> nb_blocks; k++) if (set_frontiers[s].test(k)) work.push_back(k);
+                while (work.size() != 0) {
+                        int block = work.back();
+                        work.pop_back();
+                        for (int f=0; f < a -> nb_blocks; f++) {
+                                if (frontiers[block].test(f) && iterated[s].set(f)) work.push_back(f);
+                        }
+                }
+                /* the forks going the same way on every process cannot make them diverge */
+                for (int k=0; k < a -> nb_blocks; k++) {
+                        if (blocks[k].present && !blocks[k].rank_dependent) iterated[s].reset(k);
+                }
+        }
+
+        /* warnings, in the order of the plugin */
+        bool header = false;
+        for (int s=0; s < nb_sets; s++) {
+                if (iterated[s].empty()) continue;
+                int i = set_code[s];
+                if (!header) {
+                        snprintf(line, sizeof(line), "%s: In function '%s':\n", fun -> file.c_str(), fun -> name.c_str());
+                        a -> report += line;
+                        header = true;
+                }
+                for (int k=0; k < a -> nb_blocks; k++) {
+                        if (set_rank[s] > 0 && sets[s-1].test(k) && !iterated[s-1].empty()) continue;
+                        if (!sets[s].test(k)) continue;
+                        const block_collective *c = collective_in_block(blocks[k], i);
+                        snprintf(line, sizeof(line), "%s:%d:%d: warning: Potential issue: MPI collective %s in block %d\n",
+                                        fun -> file.c_str(), c ? c -> line : 0, c ? c -> column : 0, (*fun -> collective_names)[fun -> class_code[i]].c_str(), k);
+                        a -> report += line;
+                }
+                for (int k=0; k < a -> nb_blocks; k++) {
+                        if (!iterated[s].test(k)) continue;
+                        snprintf(line, sizeof(line), "%s:%d:%d: warning: Potential issue caused by the following fork in block %d\n",
+                                        fun -> file.c_str(), blocks[k].last_line, blocks[k].last_column, k);
+                        a -> report += line;
+                }
+        }
+}
+
+/* Work stealing thread pool */
+
+/* each worker takes the functions from the back of its own queue and steals from the front of the others */
+struct worker_queue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+};
+
+static std::vector<analysis> results;
+
+static bool take_task(std::vector<worker_queue> &queues, int self, size_t *task)
+{
+        {
+                std::lock_guard<std::mutex> guard(queues[self].lock);
+                if (!queues[self].tasks.empty()) {
+                        *task = queues[self].tasks.back();
+                        queues[self].tasks.pop_back();
+                        return true;
+                }
+        }
+        for (size_t v = 1; v < queues.size(); v++) {
+                worker_queue &victim = queues[(self + v) % queues.size()];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                if (!victim.tasks.empty()) {
+                        *task = victim.tasks.front();
+                        victim.tasks.pop_front();
+                        return true;
+                }
+        }
+        return false;
+}
+
+static void worker(std::vector<worker_queue> *queues, int self)
+{
+        size_t task;
+        /* no task is created once the workers run, so empty queues mean the work is done */
+        while (take_task(*queues, self, &task)) analyze(&results[task]);
+}
+
+static void usage(const char *name)
+{
+        fprintf(stderr, "usage: %s [-j threads] [-s] file...\n", name);
+        fprintf(stderr, "  -j  number of threads (default: number of cores)\n");
+        fprintf(stderr, "  -s  print a summary line per function\n");
+}
+
+int main(int argc, char *argv[])
+{
+        int nb_threads = std::thread::hardware_concurrency();
+        bool summary = false;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "j:sh")) != -1) {
+                switch (opt) {
+                case 'j': nb_threads = atoi(optarg); break;
+                case 's': summary = true; break;
+                default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+                }
+        }
+        if (optind == argc) {
+                usage(argv[0]);
+                return 2;
+        }
+        if (nb_threads < 1) nb_threads = 1;
+
+        for (int k = optind; k < argc; k++) {
+                if (!read_export_file(argv[k])) return 2;
+        }
+
+        results.resize(functions.size());
+        std::vector<worker_queue> queues(nb_threads);
+        for (size_t f=0; f < functions.size(); f++) {
+                results[f].fun = &functions[f];
+                /* contiguous chunks, functions of the same file tend to have similar sizes */
+                queues[f * nb_threads / functions.size()].tasks.push_back(f);
+        }
+
+        std::vector<std::thread> threads;
+        for (int t=1; t < nb_threads; t++) threads.push_back(std::thread(worker, &queues, t));
+        worker(&queues, 0);
+        for (size_t t=0; t < threads.size(); t++) threads[t].join();
+
+        int nb_flagged = 0;
+        for (size_t f=0; f < results.size(); f++) {
+                fputs(results[f].report.c_str(), stdout);
+                if (!results[f].report.empty()) nb_flagged++;
+                if (summary) printf("%s:%d: %s: %s\n", functions[f].file.c_str(), functions[f].line, functions[f].name.c_str(),
+                                results[f].report.empty() ? "No potential deadlock found." : "potential deadlock");
+        }
+        fprintf(stderr, "mpicoll-analyze: %zu functions, %d with potential deadlocks, %d threads\n", functions.size(), nb_flagged, nb_threads);
+        return nb_flagged != 0;
+}
@@ -0,0 +1,93 @@
+/* Probes inserted by -fplugin-arg-libplugin-profile=<site table> around the collectives, */
+/* link the program with mpicoll_prof.o */
+
+/* Every process writes $MPICOLL_PROF_DIR/mpicoll_prof.<rank> (current directory by default) in MPI_Finalize, */
+/* one line per site called: <id> <calls> <total ns> <max ns> then <bucket>:<calls> for the calls that took */
+/* between 2^bucket and 2^(bucket+1) ns. The id is the first column of the site table. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <mpi.h>
+
+#include "../include/mpicoll_prof.h"
+
+/* sites of every profiled function of the program, defined by the linker for the section */
+extern struct mpicoll_prof_site __start_mpicoll_prof_sites[] __attribute__((weak));
+extern struct mpicoll_prof_site __stop_mpicoll_prof_sites[] __attribute__((weak));
+
+/* nanoseconds per tick of the probes */
+static double mpicoll_prof_ns_per_tick = 1.0;
+
+static unsigned long long mpicoll_prof_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* the probes of the targets without an inline time stamp counter */
+unsigned long long mpicoll_prof_ticks(void)
+{
+#ifdef MPICOLL_PROF_TICKS_ASM
+	unsigned long long ticks;
+	__asm__ __volatile__(MPICOLL_PROF_TICKS_ASM : MPICOLL_PROF_TICKS_OUTPUT (ticks) : : MPICOLL_PROF_TICKS_CLOBBER, "memory");
+	return ticks;
+#else
+	return mpicoll_prof_ns();
+#endif
+}
+
+/* the ticks are compared with the monotonic clock over a millisecond when the program starts */
+__attribute__((constructor)) static void mpicoll_prof_calibrate(void)
+{
+	unsigned long long ns = mpicoll_prof_ns(), ticks = mpicoll_prof_ticks();
+	unsigned long long elapsed;
+	while ((elapsed = mpicoll_prof_ns() - ns) < 1000000ULL);
+	unsigned long long elapsed_ticks = mpicoll_prof_ticks() - ticks;
+	if (elapsed_ticks != 0) mpicoll_prof_ns_per_tick = (double) elapsed / elapsed_ticks;
+}
+
+/* called after a collective with the ticks read around it */
+void mpicoll_prof_record(struct mpicoll_prof_site *site, unsigned long long start, unsigned long long end)
+{
+	unsigned long long elapsed = end > start ? (unsigned long long) ((end - start) * mpicoll_prof_ns_per_tick) : 0;
+
+	site->calls++;
+	site->total += elapsed;
+	if (elapsed > site->max) site->max = elapsed;
+	site->buckets[elapsed ? 63 - __builtin_clzll(elapsed) : 0]++;
+}
+
+static void mpicoll_prof_dump(void)
+{
+	int rank = 0;
+	char filename[4096];
+	const char *dir = getenv("MPICOLL_PROF_DIR");
+
+	PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	snprintf(filename, sizeof(filename), "%s/mpicoll_prof.%d", dir ? dir : ".", rank);
+	FILE *out = fopen(filename, "w");
+	if (out == NULL) {
+		perror(filename);
+		return;
+	}
+
+	for (struct mpicoll_prof_site *site = __start_mpicoll_prof_sites; site < __stop_mpicoll_prof_sites; site++) {
+		if (site->id == 0 || site->calls == 0) continue;
+		fprintf(out, "%016llx %llu %llu %llu", site->id, site->calls, site->total, site->max);
+		for (int b = 0; b < MPICOLL_PROF_BUCKETS; b++) {
+			if (site->buckets[b]) fprintf(out, " %d:%llu", b, site->buckets[b]);
+		}
+		fputc('\n', out);
+	}
+	fclose(out);
+}
+
+/* the profile is written wherever the program calls MPI_Finalize, through the profiling interface */
+int MPI_Finalize(void)
+{
+	mpicoll_prof_dump();
+	return PMPI_Finalize();
+}
@@ -0,0 +1,61 @@
+/* Runtime checks inserted by -fplugin-arg-libplugin-instrument before the collectives */
+/* that the static analysis could not prove, link the instrumented program with mpicoll_rt.o */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mpi.h>
+
+/* length of the call sites gathered on the first process when the collectives do not match */
+#define MPICOLL_RT_SITE_SIZE 256
+
+/* prints the collective every process is calling and stops the program */
+static void mpicoll_rt_report(const char *site, MPI_Comm comm)
+{
+	int rank, size;
+	char local[MPICOLL_RT_SITE_SIZE];
+	char *sites = NULL;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	strncpy(local, site, MPICOLL_RT_SITE_SIZE - 1);
+	local[MPICOLL_RT_SITE_SIZE - 1] = '\0';
+	if (rank == 0) sites = malloc((size_t) size * MPICOLL_RT_SITE_SIZE);
+
+	MPI_Gather(local, MPICOLL_RT_SITE_SIZE, MPI_CHAR, sites, MPICOLL_RT_SITE_SIZE, MPI_CHAR, 0, comm);
+	if (rank == 0) {
+		fprintf(stderr, "mpicoll: the processes do not call the same collective\n");
+		for (int r = 0; r < size; r++) {
+			fprintf(stderr, "mpicoll:   process %d calls %s\n", r, sites + (size_t) r * MPICOLL_RT_SITE_SIZE);
+		}
+		fflush(stderr);
+		MPI_Abort(comm, 1);
+	}
+	/* the other processes wait for the abort */
+	MPI_Barrier(comm);
+	exit(1);
+}
+
+/* compares the hash of the collective and of its call site between the processes of the communicator */
+void mpicoll_rt_check(unsigned long hash, const char *site, MPI_Comm comm)
+{
+	int initialized, finalized;
+	MPI_Initialized(&initialized);
+	MPI_Finalized(&finalized);
+	if (!initialized || finalized) return;
+
+	/* the maximum of the complement is the complement of the minimum */
+	unsigned long local[2] = {hash, ~hash};
+	unsigned long global[2];
+	MPI_Allreduce(local, global, 2, MPI_UNSIGNED_LONG, MPI_MAX, comm);
+	if (global[0] == hash && global[1] == ~hash) return;
+
+	mpicoll_rt_report(site, comm);
+}
+
+/* for the collectives without communicator (MPI_Finalize) */
+void mpicoll_rt_check_world(unsigned long hash, const char *site)
+{
+	mpicoll_rt_check(hash, site, MPI_COMM_WORLD);
+}
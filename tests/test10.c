@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (main)
+
+int main(int argc, char * argv[])
+{
+	int rank, size;
+	double local, global;
+	double a, b, c, d, e;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	local = rank * 2.5;
+	MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+	/* independent of local and global, can overlap the reduction */
+	a = rank * 3.0;
+	b = a * a + size;
+	c = b / 2.0 - a;
+	d = c * c + b;
+	e = d - a * b;
+
+	/* the reduction must be complete here */
+	global = global / size + e;
+
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	/* the receive buffer is used right away, no suggestion */
+	MPI_Allreduce(&global, &local, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	a = local + 1.0;
+	b = a * 2.0;
+	c = b * 3.0;
+	d = c * 4.0;
+
+	printf("%f %f %f\n", global, local, d);
+
+	MPI_Finalize();
+	return 0;
+}
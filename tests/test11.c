@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (main)
+
+#define N 100
+
+int main(int argc, char * argv[])
+{
+	int i, rank;
+	double x[N], y[N];
+	double xx = 0.0, xy = 0.0, yy = 0.0;
+	double norm_x, dot, norm_y, scaled;
+	int n = N;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	for (i = 0; i < N; i++) {
+		x[i] = rank + i;
+		y[i] = rank - i;
+	}
+	for (i = 0; i < N; i++) {
+		xx += x[i] * x[i];
+		xy += x[i] * y[i];
+		yy += y[i] * y[i];
+	}
+
+	/* three independent sums, they could be a single reduction of 3 elements */
+	MPI_Allreduce(&xx, &norm_x, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(&xy, &dot, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	rank = rank + 1;
+	MPI_Allreduce(&yy, &norm_y, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+	/* the second reduction uses the result of the first one, no fusion */
+	MPI_Allreduce(&dot, &scaled, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Allreduce(&scaled, &dot, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+	/* same operation on arrays, the counts are added */
+	MPI_Reduce(x, y, n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&xy, &dot, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+	printf("%f %f %f %f\n", norm_x, dot, norm_y, y[0]);
+
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (main, other_communicator)
+
+void other_communicator(MPI_Comm comm)
+{
+	/* different communicators, both barriers are needed */
+	MPI_Barrier(comm);
+	MPI_Barrier(MPI_COMM_WORLD);
+}
+
+int main(int argc, char * argv[])
+{
+	int rank, a = 0;
+	double local, global;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	/* two barriers in a row, one of them is redundant */
+	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Barrier(MPI_COMM_WORLD);
+	printf("%d\n", rank);
+
+	/* the reduction synchronizes the processes, the branch has no communication */
+	local = rank;
+	MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	if (global > 10.0) a = 2;
+	else a = 3;
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	/* the output is a side effect, the barrier orders it */
+	printf("%d\n", a);
+	MPI_Barrier(MPI_COMM_WORLD);
+	printf("%d\n", rank);
+
+	/* right after a reduction, the barrier is redundant: with remove its result becomes MPI_SUCCESS */
+	MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	if (MPI_Barrier(MPI_COMM_WORLD) != MPI_SUCCESS) MPI_Abort(MPI_COMM_WORLD, 1);
+
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check main
+
+int main(int argc, char * argv[])
+{
+	int rank;
+	double local, global;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	/* called by every process, it is not checked at run time */
+	local = rank;
+	MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+	/* the even processes call one more barrier, the check stops the program */
+	/* with the call site of every process instead of a deadlock */
+	if (rank % 2 == 0) {
+		MPI_Barrier(MPI_COMM_WORLD);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	printf("rank %d: %f\n", rank, global);
+
+	MPI_Finalize();
+	return 0;
+}
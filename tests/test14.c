@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check main
+
+#define ITERATIONS 1000
+
+/* not checked: the profile is written by the MPI_Finalize of the runtime wherever it is called */
+void finish(void)
+{
+	MPI_Finalize();
+}
+
+int main(int argc, char * argv[])
+{
+	int i, rank, root_value = 0;
+	double local, global = 0.0;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	/* each site gets its own histogram in the profile of every process */
+	for (i = 0; i < ITERATIONS; i++) {
+		local = rank + i;
+		MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+		if (rank == 0) root_value = i;
+		MPI_Bcast(&root_value, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	printf("rank %d: %f %d\n", rank, global, root_value);
+
+	finish();
+	return 0;
+}
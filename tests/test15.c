@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (main, through_parameter)
+
+/* the communicator of a parameter is unknown, the barriers are matched together */
+void through_parameter(MPI_Comm comm, int c)
+{
+	if (c > 0) MPI_Barrier(comm);
+	else MPI_Barrier(MPI_COMM_WORLD);
+}
+
+int main(int argc, char * argv[])
+{
+	int rank, color;
+	MPI_Comm half;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	color = rank % 2;
+	MPI_Comm_split(MPI_COMM_WORLD, color, rank, &half);
+
+	/* every process calls one barrier on its half, then one on all the processes */
+	/* the barriers on half and on MPI_COMM_WORLD are in different sets, no warning */
+	MPI_Barrier(half);
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	/* only the processes of one half synchronize: warning on the barrier on half only */
+	if (color == 0) {
+		MPI_Barrier(half);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	through_parameter(half, color);
+
+	MPI_Comm_free(&half);
+	MPI_Finalize();
+	return 0;
+}
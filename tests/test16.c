@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check main
+
+int main(int argc, char * argv[])
+{
+	int rank, i;
+	int steps = 4;
+	double local = 1.0, global;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	/* the trip count is the same on every process, the fork of the loop is not reported */
+	for (i = 0; i < steps; i++) {
+		if (i % 2 == 0) MPI_Barrier(MPI_COMM_WORLD);
+	}
+
+	/* the value of odd depends on the rank, so does the fork: warning */
+	int odd = rank % 2;
+	if (odd) {
+		MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	}
+
+	/* the environment may differ between processes: warning */
+	if (getenv("MPICOLL_SYNC") != NULL) {
+		MPI_Barrier(MPI_COMM_WORLD);
+	}
+
+	printf("rank %d: %f\n", rank, global);
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (main, reduce_masters)
+
+/* the barrier depends on the path, the wrapper cannot be summarized */
+static inline void sync_masters(int rank)
+{
+	if (rank % 4 == 0) MPI_Barrier(MPI_COMM_WORLD);
+}
+
+static inline void reduce_on_masters(int rank, double *value, double *sum)
+{
+	if (rank % 4 == 0) MPI_Reduce(value, sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+}
+
+/* listed too, examined at both placements: warning on the reduction once its wrapper is inlined */
+void reduce_masters(int rank, double *value)
+{
+	double sum;
+	reduce_on_masters(rank, value, &sum);
+}
+
+int main(int argc, char * argv[])
+{
+	int rank;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	/* after the cfg pass the call is opaque: no warning */
+	/* after the early optimizations the wrapper is inlined: warning on the barrier and its fork */
+	/* "Now starting to examine function main after early_optimizations" comes before that warning */
+	sync_masters(rank);
+
+	double value = rank;
+	reduce_masters(rank, &value);
+
+	printf("rank %d\n", rank);
+	MPI_Finalize();
+	return 0;
+}
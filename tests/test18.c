@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check main
+
+int main(int argc, char * argv[])
+{
+	int rank, i, j, k, l;
+	int steps = 8;
+	double local = 1.0, global;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	/* both loops are summarized, an iteration of the outer one counts 1 MPI_Allreduce and the summary of the inner loop, 1 MPI_Barrier: no warning */
+	for (i = 0; i < steps; i++) {
+		MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+		for (j = 0; j < 3; j++) {
+			MPI_Barrier(MPI_COMM_WORLD);
+		}
+	}
+
+	/* the loop is under a fork depending on the rank, so is its counter: warning on its MPI_Bcast, the fork and the loop */
+	if (rank == 0) {
+		for (k = 0; k < steps; k++) {
+			MPI_Bcast(&local, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		}
+	}
+
+	/* the trip count depends on the rank, the loop is not summarized: warning on its MPI_Reduce and on the loop */
+	for (l = 0; l < rank; l++) {
+		MPI_Reduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	}
+
+	printf("rank %d: %f\n", rank, global);
+	MPI_Finalize();
+	return 0;
+}
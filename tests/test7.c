@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check_match ("solver_*", "halo_?")
+#pragma Projet_CA mpicoll_check_match "unused_*"
+
+void solver_step(int c) {
+	if (c > 5) {
+		MPI_Barrier(MPI_COMM_WORLD);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+}
+
+void halo_x(int c) {
+	MPI_Barrier(MPI_COMM_WORLD);
+}
+
+void halo_xy(int c) {
+	if (c > 5) MPI_Barrier(MPI_COMM_WORLD);
+}
+
+__attribute__((mpicoll_check)) void kernel(int c) {
+	if (c > 10) {
+		MPI_Barrier(MPI_COMM_WORLD);
+	} else MPI_Barrier(MPI_COMM_WORLD);
+}
+
+int main(int argc, char * argv[])
+{
+	MPI_Init(&argc, &argv);
+	solver_step(argc);
+	halo_x(argc);
+	halo_xy(argc);
+	kernel(argc);
+	MPI_Finalize();
+	return 1;
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (same_sequence, different_sequence, main)
+
+static void halo_exchange(int c);
+
+void sync_all() {
+	MPI_Barrier(MPI_COMM_WORLD);
+}
+
+void reduce_and_sync(int *x, int *sum) {
+	MPI_Reduce(x, sum, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+	sync_all();
+}
+
+void maybe_sync(int c) {
+	if (c > 5) MPI_Barrier(MPI_COMM_WORLD);
+}
+
+void same_sequence(int c) {
+	if (c > 5) {
+		sync_all();
+	} else MPI_Barrier(MPI_COMM_WORLD);
+	maybe_sync(c);
+}
+
+void different_sequence(int c, int *x, int *sum) {
+	if (c > 5) {
+		reduce_and_sync(x, sum);
+	} else sync_all();
+}
+
+int main(int argc, char * argv[])
+{
+	int x = argc, sum;
+	MPI_Init(&argc, &argv);
+	if (argc > 2) halo_exchange(argc);
+	else MPI_Barrier(MPI_COMM_WORLD);
+	same_sequence(argc);
+	different_sequence(argc, &x, &sum);
+	MPI_Finalize();
+	return 1;
+}
+
+static void halo_exchange(int c) {
+	for (int i = 0; i < c; i++) {
+		c = c * 2;
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mpi.h>
+
+#pragma Projet_CA mpicoll_check (main)
+
+void comm_sync(MPI_Comm comm);
+void comm_norm(double *local, double *global);
+void comm_maybe_sync(int c);
+
+int main(int argc, char * argv[])
+{
+	double local = argc, global;
+	MPI_Init(&argc, &argv);
+	if (argc > 2) {
+		comm_norm(&local, &global);
+	} else comm_sync(MPI_COMM_WORLD);
+	comm_maybe_sync(argc);
+	MPI_Finalize();
+	return 1;
+}
@@ -0,0 +1,14 @@
+#include <mpi.h>
+
+void comm_sync(MPI_Comm comm) {
+	MPI_Barrier(comm);
+}
+
+void comm_norm(double *local, double *global) {
+	MPI_Reduce(local, global, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	comm_sync(MPI_COMM_WORLD);
+}
+
+void comm_maybe_sync(int c) {
+	if (c > 5) MPI_Barrier(MPI_COMM_WORLD);
+}